@@ -0,0 +1,125 @@
+/* vim: set sw=4 ts=4 et : */
+/* alloc-gtest.cpp: allocation checks for matchers
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Checks that matching does not allocate. Unlike the samples,
+ * all the tests in this file are expected to pass
+ */
+#include <list>
+#include <string>
+#include <vector>
+#define MATCHA_GTEST
+#define MATCHA_TRACK_ALLOCATIONS
+#include "matcha/matcha.hpp"
+#include "matcha/alloc_tracking.hpp"
+#include "matcha/spy.hpp"
+
+using namespace matcha;
+
+TEST(Allocations, testEqualTo) {
+    std::string s("a string long enough to live on the heap");
+    assertThat(equalTo(s), matchesWithoutAllocating(s));
+    assertThat(equalTo(42), matchesWithoutAllocating(42));
+}
+
+TEST(Allocations, testStringLiterals) {
+    assertThat(equalTo("hello"), matchesWithoutAllocating("hello"));
+    assertThat(startsWith("hello"), matchesWithoutAllocating("hello world"));
+    assertThat(endsWith("world"), matchesWithoutAllocating("hello world"));
+    assertThat(contains("lo wo"), matchesWithoutAllocating("hello world"));
+}
+
+TEST(Allocations, testLongLiterals) {
+    assertThat(equalTo(std::string("a literal longer than the small-string buffer")),
+               matchesWithoutAllocating("a literal longer than the small-string buffer"));
+    assertThat(startsWith("a literal"), matchesWithoutAllocating("a literal longer than the small-string buffer"));
+    assertThat(equalToIgnoringCase("A LITERAL LONGER THAN THE SMALL-STRING BUFFER"),
+               matchesWithoutAllocating("a literal longer than the small-string buffer"));
+}
+
+TEST(Allocations, testIgnoringCase) {
+    assertThat(equalToIgnoringCase("Hello World"), matchesWithoutAllocating("hello world"));
+}
+
+TEST(Allocations, testIgnoringWhiteSpace) {
+    assertThat(equalToIgnoringWhiteSpace("hello world"), matchesWithoutAllocating("  hello  world "));
+}
+
+TEST(Allocations, testEditDistance) {
+    assertThat(withinEditDistance("kitten", 3), matchesWithoutAllocating("sitting"));
+    assertThat(containsApproximately("brown", 1), matchesWithoutAllocating("the quick brwn fox"));
+}
+
+TEST(Allocations, testContainers) {
+    std::vector<int> v{1, 2, 3};
+    assertThat(contains(2), matchesWithoutAllocating(v));
+    assertThat(everyItem(greaterThan(0)), matchesWithoutAllocating(v));
+    assertThat(hasSize(3), matchesWithoutAllocating(v));
+}
+
+TEST(Allocations, testOneOf) {
+    std::vector<std::string> names{"a name longer than the small-string buffer", "another such name"};
+    assertThat(in(names), matchesWithoutAllocating("a name longer than the small-string buffer"));
+    assertThat(in(sorted(borrow(names))), matchesWithoutAllocating("a name longer than the small-string buffer"));
+    assertThat(oneOf("a name longer than the small-string buffer", "another such name"),
+               matchesWithoutAllocating("another such name"));
+}
+
+TEST(Allocations, testContainsInAnyOrder) {
+    std::vector<std::string> expected{"a string long enough to live on the heap",
+                                      "another one, just as long as the first"};
+    std::vector<std::string> actual(expected.rbegin(), expected.rend());
+    auto m = containsInAnyOrder(expected);
+    m.matches(actual);  // sizes the tally of this thread
+    assertThat(m, matchesWithoutAllocating(actual));
+}
+
+TEST(Allocations, testIsSorted) {
+    std::list<std::string> names{"a string long enough to live on the heap",
+                                 "another one, just as long as the first"};
+    assertThat(isSorted(), matchesWithoutAllocating(names));
+}
+
+TEST(Allocations, testCombinators) {
+    assertThat(allOf(greaterThan(0), lessThan(10)), matchesWithoutAllocating(5));
+    assertThat(anyOf(equalTo(1), equalTo(5)), matchesWithoutAllocating(5));
+}
+
+TEST(Allocations, testCachedDescription) {
+    auto m = anyOf(equalTo(std::string("a string long enough to live on the heap")),
+                   equalTo(std::string("another one, just as long as the first")));
+    allocationsOfDescribe(m);
+    assertThat(allocationsOfDescribe(m).allocations, equalTo(size_t(0)));
+}
+
+TEST(Allocations, testBudget) {
+    std::vector<int> v;
+    v.reserve(16);
+    assertThat([&]{ v.assign(16, 0); }, allocatesAtMost(0));
+    assertThat([&]{ std::vector<int> w(256); }, allocatesAtMost(1, 1024));
+}
+
+TEST(Allocations, testSpyRecording) {
+    Spy<int, std::string> send(16, 2);
+    std::string message("a message longer than the small-string buffer");
+    send(0, message);
+    assertThat([&]{ send(1, message); }, allocatesAtMost(0));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,78 @@
+/* vim: set sw=4 ts=4 et : */
+/* bench-rules.cpp: rules compiled at runtime vs the same template matchers
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Micro-benchmark (Google Benchmark) of matcher expressions compiled by
+ * rule() against the equivalent matchers built from templates
+ *
+ */
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "matcha/rules.hpp"
+
+static std::vector<std::string> requests() {
+    std::vector<std::string> v;
+    for (int i = 0; i < 1024; ++i)
+        v.push_back(i % 3 ? "GET /index.html HTTP/1.1" : i % 5 ? "POST /form HTTP/2" : "GET /../etc HTTP/1.1");
+    return v;
+}
+
+static std::vector<int> amounts() {
+    std::vector<int> v;
+    for (int i = 0; i < 1024; ++i)
+        v.push_back((i * 7919) % 2000 - 500);
+    return v;
+}
+
+template<class C, class M>
+static void run(benchmark::State& state, C const& input, M const& matcher) {
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto const& x : input)
+            n += matcher.matches(x);
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+static void RequestTemplate(benchmark::State& state) {
+    using namespace matcha;
+    run(state, requests(), allOf(anyOf(startsWith("GET "), startsWith("POST ")),
+                                 not(contains(std::string(".."))),
+                                 anyOf(endsWith("HTTP/1.1"), endsWith("HTTP/2"))));
+}
+BENCHMARK(RequestTemplate);
+
+static void RequestRule(benchmark::State& state) {
+    run(state, requests(), matcha::rule("allOf(anyOf(startsWith(\"GET \"), startsWith(\"POST \")),"
+                                        "      not(contains(\"..\")),"
+                                        "      anyOf(endsWith(\"HTTP/1.1\"), endsWith(\"HTTP/2\")))"));
+}
+BENCHMARK(RequestRule);
+
+static void AmountTemplate(benchmark::State& state) {
+    using namespace matcha;
+    run(state, amounts(), anyOf(equalTo(0), allOf(greaterThan(0), lessThanOrEqualTo(1000))));
+}
+BENCHMARK(AmountTemplate);
+
+static void AmountRule(benchmark::State& state) {
+    run(state, amounts(), matcha::rule("anyOf(equalTo(0), allOf(greaterThan(0), lessThanOrEqualTo(1000)))"));
+}
+BENCHMARK(AmountRule);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,76 @@
+/* vim: set sw=4 ts=4 et : */
+/* bench-strings.cpp: string matchers on runtime vs compile-time literals
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Micro-benchmark (Google Benchmark) of startsWith, endsWith and equalTo
+ * built from a std::string against the same matchers built with MATCHA_LIT
+ *
+ */
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "matcha/matcha.hpp"
+
+static std::vector<std::string> requests() {
+    std::vector<std::string> v;
+    for (int i = 0; i < 1024; ++i)
+        v.push_back(i % 3 ? "GET /index.html HTTP/1.1" : "POST /form HTTP/1.1");
+    return v;
+}
+
+template<class M>
+static void run(benchmark::State& state, M const& matcher) {
+    auto const input = requests();
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto const& s : input)
+            n += matcher.matches(s);
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * input.size());
+}
+
+static void StartsWithRuntime(benchmark::State& state) {
+    run(state, matcha::startsWith("GET "));
+}
+BENCHMARK(StartsWithRuntime);
+
+static void StartsWithLiteral(benchmark::State& state) {
+    run(state, matcha::startsWith(MATCHA_LIT("GET ")));
+}
+BENCHMARK(StartsWithLiteral);
+
+static void EndsWithRuntime(benchmark::State& state) {
+    run(state, matcha::endsWith(" HTTP/1.1"));
+}
+BENCHMARK(EndsWithRuntime);
+
+static void EndsWithLiteral(benchmark::State& state) {
+    run(state, matcha::endsWith(MATCHA_LIT(" HTTP/1.1")));
+}
+BENCHMARK(EndsWithLiteral);
+
+static void EqualToRuntime(benchmark::State& state) {
+    run(state, matcha::equalTo(std::string("GET /index.html HTTP/1.1")));
+}
+BENCHMARK(EqualToRuntime);
+
+static void EqualToLiteral(benchmark::State& state) {
+    run(state, matcha::equalTo(MATCHA_LIT("GET /index.html HTTP/1.1")));
+}
+BENCHMARK(EqualToLiteral);
+
+BENCHMARK_MAIN();
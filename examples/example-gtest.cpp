@@ -25,8 +25,22 @@
 #include <set>
 #include <map>
 #include <array>
+#include <sstream>
+#include <thread>
 #define MATCHA_GTEST
 #include "matcha/matcha.hpp"
+#include "gtest/gtest-spi.h"
+#include "matcha/mapped_file.hpp"
+#include "matcha/batch.hpp"
+#include "matcha/table.hpp"
+#include "matcha/latency.hpp"
+#include "matcha/baseline.hpp"
+#include "matcha/spy.hpp"
+#include "matcha/sequence.hpp"
+#include "matcha/snapshot.hpp"
+#include "matcha/soft.hpp"
+#include "matcha/incremental.hpp"
+#include "matcha/rules.hpp"
 
 using namespace matcha;
 
@@ -148,6 +162,11 @@ TEST(Matcha, testStringEveryItem) {
 }
 
 
+TEST(Matcha, testStringLiteralStartsWith) {
+    std::string request("POST /index.html HTTP/1.1");
+    assertThat(request, startsWith(MATCHA_LIT("GET ")));
+}
+
 TEST(Matcha, testStringIgnoreCase) {
     assertThat("foo", is(equalToIgnoringCase("Foo")));
 }
@@ -195,6 +214,10 @@ TEST(Matcha, testStringIsEmpty) {
     assertThat(s, is(emptyString()));
 }
 
+// matchers on arithmetic values can be evaluated at compile time
+static_assert(lessThan(8080).matches(443), "port below 8080");
+static_assert(is(not(closeTo(0.5, 0.1))).matches(0.25), "ratio away from 0.5");
+
 TEST(Matcha, testLessThanInteger) {
     assertThat(1, is(lessThan(1)));
 }
@@ -216,6 +239,179 @@ TEST(Matcha, testExample) {
     assertThat(tautogram, not(everyItem(endsWith("i"))));
 }
 
+TEST(Matcha, testMappedFileLines) {
+    assertThat(linesOf(__FILE__), everyItem(startsWith("//")));
+}
+
+TEST(Matcha, testMappedFileContains) {
+    assertThat(mappedFile(__FILE__), not(contains("TEST(")));
+}
+
+TEST(Matcha, testStreamEveryItem) {
+    std::istringstream readings("12 15 9 31 14 18 22 27 40 11");
+    assertThat(streamOf<int>(readings), everyItem(lessThan(30)));
+}
+
+TEST(Matcha, testHasSize) {
+    std::vector<int> v = { 3, 5, 1 };
+    assertThat(v, hasSize(greaterThan(3)));
+}
+
+TEST(Matcha, testAtLeast) {
+    std::vector<int> v = { 3, 5, 1, 8 };
+    assertThat(v, atLeast(3, greaterThan(2)));
+    assertThat(v, exactly(2, greaterThan(4)));
+    assertThat(v, atMost(1, lessThan(4)));
+}
+
+TEST(Matcha, testBatchValidation) {
+    std::vector<int> records(100000);
+    for (size_t i = 0; i < records.size(); ++i)
+        records[i] = i % 1000;
+    BatchResult result = validateBatch(records, lessThan(990));
+    assertThat(result.failures(), equalTo(size_t(0)));
+}
+
+TEST(Matcha, testEveryItemCollect) {
+    std::vector<int> v(100000);
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = i % 997;
+    assertThat(v, everyItem(lessThan(990), collect(3)));
+}
+
+TEST(Matcha, testColumnarTable) {
+    std::vector<long> ids = { 1, 2, 3, 4 };
+    std::vector<double> prices = { 9.5, 10.25, 31.0, 10.0 };
+    std::vector<std::string> symbols = { "AAPL", "AMZN", "MSFT", "ADBE" };
+    assertThat(std::tie(ids, prices, symbols),
+               table(column("id", greaterThan(0L)),
+                     column("price", closeTo(10.0, 1.0)),
+                     column("symbol", startsWith("A"))));
+}
+
+TEST(Matcha, testBaseline) {
+    BaselineFile file(testing::TempDir() + "matcha-example-baseline.json");
+    std::remove(file.path().c_str());
+    auto fast = [] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+    auto slow = [] { std::this_thread::sleep_for(std::chrono::milliseconds(2)); };
+    assertThat(fast, noSlowerThanBaseline("lookup", percent(10), file, 5, 1));  // records it
+    assertThat(slow, noSlowerThanBaseline("lookup", percent(10), file, 5, 1));
+}
+
+TEST(Matcha, testLatencyBudget) {
+    auto lookup = []{ std::this_thread::sleep_for(std::chrono::milliseconds(3)); };
+    assertThat(lookup, completesWithin(std::chrono::milliseconds(2), 5));
+}
+
+TEST(Matcha, testSpy) {
+    Spy<int, std::string> send;
+    send(1, "hello");
+    send(2, "world");
+    assertThat(send, calledWith(equalTo(3), startsWith("x")));
+}
+
+TEST(Matcha, testEventSequence) {
+    std::vector<std::string> log{"open", "read", "read", "read", "close"};
+    assertThat(log, within(4, sequence(startsWith("open"),
+                                       zeroOrMore(startsWith("read")),
+                                       startsWith("close"))));
+}
+
+TEST(Matcha, testSnapshot) {
+    std::ostringstream report;
+    for (int i = 0; i < 1000; ++i)
+        report << "row " << i << ": " << i * i << "\n";
+    assertThat(report.str(), matchesSnapshot("report.golden"));
+
+    std::string changed = report.str();
+    changed[changed.find("row 500")] = 'R';
+    assertThat(changed, matchesSnapshot("report.golden"));
+}
+
+TEST(Matcha, testContainsInAnyOrder) {
+    std::vector<std::string> received{"ack", "data", "fin", "data"};
+    assertThat(received, containsInAnyOrder({std::string("data"), std::string("ack"),
+                                             std::string("syn"), std::string("data")}));
+}
+
+TEST(Matcha, testContainsInOrder) {
+    std::vector<int> trace{1, 5, 2, 7, 3};
+    assertThat(trace, containsInOrder({1, 2, 5}));
+}
+
+TEST(Matcha, testEditDistance) {
+    std::string ocr = "Tbe qnick brown f0x";
+    assertThat(ocr, containsApproximately("quick", 1));
+    assertThat(ocr, withinEditDistance("The quick brown fox", 2));
+}
+
+TEST(Matcha, testSoftAssertions) {
+    SoftAssertions soft;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&soft, t] {
+            for (int i = 0; i < 1000; ++i)
+                softAssertThat(soft, i * t, lessThan(2500));
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+TEST(Matcha, testSoftAssertionsAlternating) {
+    testing::TestPartResultArray reported;
+    size_t threads[2];
+    {
+        testing::ScopedFakeTestPartResultReporter intercept(
+            testing::ScopedFakeTestPartResultReporter::INTERCEPT_ONLY_CURRENT_THREAD, &reported);
+        SoftAssertions first, second;
+        for (int i = 0; i < 50; ++i) {
+            softAssertThat(first, i, lessThan(0));
+            softAssertThat(second, i, lessThan(0));
+        }
+        threads[0] = first.threads();
+        threads[1] = second.threads();
+    }
+    assertThat(threads[0], equalTo(size_t(1)));
+    assertThat(threads[1], equalTo(size_t(1)));
+    assertThat(reported.size(), equalTo(100));
+}
+
+TEST(Matcha, testBorrowedValues) {
+    std::set<int> known{2, 3, 5, 7, 11, 13};
+    auto prime = anyOf(in(borrow(known)), greaterThan(100));
+    assertThat(9, prime);
+}
+
+TEST(Matcha, testIncremental) {
+    std::vector<int> results;
+    auto allPositive = incremental(everyItem(greaterThan(0)));
+    for (int batch = 0; batch < 3; ++batch) {
+        for (int i = 0; i < 4; ++i)
+            results.push_back(10 - 4 * batch - i);
+        assertThat(results, allPositive);
+    }
+}
+
+TEST(Matcha, testRule) {
+    auto request = rule("allOf(startsWith(\"GET \"), not(contains(\"..\")))");
+    assertThat(std::string("GET /index.html"), request);
+    assertThat(std::string("GET /../etc/passwd"), request);
+}
+
+TEST(Matcha, testSorted) {
+    std::vector<int> ids{3, 8, 15, 15, 21};
+    assertThat(15, in(sorted(borrow(ids))));
+    assertThat(ids, isStrictlySorted());
+}
+
+TEST(Matcha, testSetRelations) {
+    std::set<std::string> granted{"read", "write"};
+    std::vector<std::string> requested{"read", "admin", "write"};
+    assertThat(requested, intersects(borrow(granted)));
+    assertThat(requested, subsetOf(borrow(granted)));
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,248 @@
+/* vim: set sw=4 ts=4 et : */
+/* alloc_tracking.hpp: counting heap allocations made by matchers
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_ALLOC_TRACKING_H_
+#define _MATCHA_ALLOC_TRACKING_H_
+
+#include <cstdlib>
+#include <new>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * Allocations are counted by replacing the global operator new. The
+ * replacement can only be defined once per program, so exactly one
+ * translation unit must define MATCHA_TRACK_ALLOCATIONS before including
+ * this header; everywhere else the counters are merely read.
+ */
+
+struct AllocationCount {
+    size_t allocations;
+    size_t bytes;
+};
+
+inline std::ostream& operator<<(std::ostream& o, AllocationCount const& c) {
+    return o << c.allocations << " allocations (" << c.bytes << " bytes)";
+}
+
+// running totals for the calling thread
+inline AllocationCount& allocation_counter() {
+    static thread_local AllocationCount count;
+    return count;
+}
+
+// set once the operator new replacement is linked in
+inline bool& allocation_tracking_enabled() {
+    static bool enabled = false;
+    return enabled;
+}
+
+// counts the allocations made by the calling thread during its lifetime
+class AllocationScope {
+public:
+    AllocationScope() : start_(allocation_counter())
+    { }
+
+    AllocationCount count() const {
+        AllocationCount now = allocation_counter();
+        return AllocationCount{ now.allocations - start_.allocations, now.bytes - start_.bytes };
+    }
+
+private:
+    AllocationCount start_;
+};
+
+template<typename M, typename T>
+AllocationCount allocationsOfMatch(M const& matcher, T const& actual) {
+    AllocationScope scope;
+    matcher.matches(actual);
+    return scope.count();
+}
+
+// describing is allowed to allocate, failures are the slow path anyway
+template<typename M>
+AllocationCount allocationsOfDescribe(M const& matcher) {
+    AllocationScope scope;
+    FormatBuffer buffer;
+    FormatStream o(buffer);
+    o << matcher;
+    return scope.count();
+}
+
+/*
+ * matches a matcher (not a value!) that matches the expected value without
+ * allocating on the heap, e.g.
+ *
+ *   assertThat(equalToIgnoringCase("hello"), matchesWithoutAllocating("HELLO"));
+ */
+struct MatchesWithoutAllocating_ {
+protected:
+    template<typename T, typename M>
+    bool matches(T const& value, M const& matcher) const {
+        if (!allocation_tracking_enabled())
+            return false;
+        AllocationScope scope;
+        bool matched = matcher.matches(value);
+        return matched && scope.count().allocations == 0;
+    }
+
+    template<typename T>
+    void describe(std::ostream& o, T const& value) const {
+        o << "a matcher matching " << value << " without allocating";
+    }
+
+    template<typename T, typename M>
+    void describeMismatch(std::ostream& o, T const& value, M const& matcher) const {
+        if (!allocation_tracking_enabled()) {
+            o << "nothing, define MATCHA_TRACK_ALLOCATIONS in one source file to count allocations";
+            return;
+        }
+        AllocationScope scope;
+        bool matched = matcher.matches(value);
+        o << matcher << ", which " << (matched ? "matched" : "didn't match")
+          << " after " << scope.count();
+    }
+};
+
+template<typename T>
+using MatchesWithoutAllocating = Matcher<MatchesWithoutAllocating_,T>;
+
+template<typename T>
+MatchesWithoutAllocating<T> matchesWithoutAllocating(T const& value) {
+    return MatchesWithoutAllocating<T>(value);
+}
+
+// a literal is handed to the matcher under test as the char array it is
+template<size_t N>
+MatchesWithoutAllocating<Borrowed<char[N]>> matchesWithoutAllocating(char const (&value)[N]) {
+    return MatchesWithoutAllocating<Borrowed<char[N]>>(borrow(value));
+}
+
+// a limit on the allocations of a callable
+struct AllocationBudget {
+    AllocationCount limit;
+};
+
+/*
+ * matches a callable that allocates no more than the given number of
+ * blocks and bytes when called once, e.g.
+ *
+ *   assertThat([&]{ parser.parse(line); }, allocatesAtMost(1, 256));
+ */
+struct AllocatesAtMost_ {
+protected:
+    template<typename F>
+    bool matches(AllocationBudget const& budget, F const& callable) const {
+        if (!allocation_tracking_enabled())
+            return false;
+        AllocationCount measured = count(callable);
+        LastMatch<AllocationCount>::record(&budget, &callable, measured);
+        return measured.allocations <= budget.limit.allocations
+            && measured.bytes <= budget.limit.bytes;
+    }
+
+    void describe(std::ostream& o, AllocationBudget const& budget) const {
+        o << "a callable making at most " << budget.limit.allocations << " allocations";
+        if (budget.limit.bytes != unlimited)
+            o << " (" << budget.limit.bytes << " bytes)";
+    }
+
+    // the count made by matches(), or a new one if there is none
+    template<typename F>
+    void describeMismatch(std::ostream& o, AllocationBudget const& budget, F const& callable) const {
+        if (!allocation_tracking_enabled()) {
+            o << "nothing, define MATCHA_TRACK_ALLOCATIONS in one source file to count allocations";
+            return;
+        }
+        AllocationCount const* recorded = LastMatch<AllocationCount>::find(&budget, &callable);
+        o << (recorded ? *recorded : count(callable));
+    }
+
+private:
+    static constexpr size_t unlimited = size_t(-1);
+
+    template<typename F>
+    static AllocationCount count(F const& callable) {
+        AllocationScope scope;
+        callable();
+        return scope.count();
+    }
+};
+
+using AllocatesAtMost = Matcher<AllocatesAtMost_,AllocationBudget>;
+
+inline AllocatesAtMost allocatesAtMost(size_t allocations, size_t bytes = size_t(-1)) {
+    return AllocatesAtMost(AllocationBudget{ { allocations, bytes } });
+}
+
+} // namespace matcha
+
+#ifdef MATCHA_TRACK_ALLOCATIONS
+
+namespace matcha {
+namespace {
+
+struct AllocationHook {
+    AllocationHook() { allocation_tracking_enabled() = true; }
+} allocation_hook;
+
+inline void* counted_alloc(size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    AllocationCount& count = allocation_counter();
+    ++count.allocations;
+    count.bytes += size;
+    return p;
+}
+
+} // anonymous namespace
+} // namespace matcha
+
+void* operator new(size_t size) {
+    return matcha::counted_alloc(size);
+}
+
+void* operator new[](size_t size) {
+    return matcha::counted_alloc(size);
+}
+
+// the nothrow versions of the standard library forward to these
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+#endif
+
+#endif // MATCHA_TRACK_ALLOCATIONS
+
+#endif // _MATCHA_ALLOC_TRACKING_H_
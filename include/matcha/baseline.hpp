@@ -0,0 +1,241 @@
+/* vim: set sw=4 ts=4 et : */
+/* baseline.hpp: timing regressions against a stored baseline
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_BASELINE_H_
+#define _MATCHA_BASELINE_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include "latency.hpp"
+
+namespace matcha {
+
+/*
+ * baseline timings, in nanoseconds, kept as a flat JSON object:
+ *
+ *   { "parse-small": 1520, "parse-large": 98231 }
+ *
+ * The file is read on every check and rewritten (through a temporary file
+ * and a rename) when a timing is recorded, so keys of other tests survive.
+ */
+class BaselineFile {
+public:
+    // MATCHA_BASELINE names the file, MATCHA_UPDATE_BASELINE=1 records new timings
+    static BaselineFile fromEnvironment() {
+        const char* path = std::getenv("MATCHA_BASELINE");
+        const char* update = std::getenv("MATCHA_UPDATE_BASELINE");
+        return BaselineFile(path && *path ? path : "matcha-baseline.json",
+                            update && *update && std::string(update) != "0");
+    }
+
+    explicit BaselineFile(std::string const& path, bool update = false)
+        : path_(path), update_(update)
+    { }
+
+    std::string const& path() const { return path_; }
+    bool updating() const { return update_; }
+
+    // the stored timing for key, if any
+    bool lookup(std::string const& key, double& ns) const {
+        std::map<std::string,double> entries = load();
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return false;
+        ns = it->second;
+        return true;
+    }
+
+    bool record(std::string const& key, double ns) const {
+        std::map<std::string,double> entries = load();
+        entries[key] = ns;
+
+        std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp.c_str());
+            out << "{";
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                out << (it == entries.begin() ? "\n  \"" : ",\n  \"");
+                for (char c : it->first) {
+                    if (c == '"' || c == '\\')
+                        out << '\\';
+                    out << c;
+                }
+                out << "\": " << uint64_t(it->second + 0.5);
+            }
+            out << "\n}\n";
+            if (!out)
+                return false;
+        }
+        return std::rename(tmp.c_str(), path_.c_str()) == 0;
+    }
+
+private:
+    // parses the flat object, ignoring anything that isn't a "key": number pair
+    std::map<std::string,double> load() const {
+        std::map<std::string,double> entries;
+        std::ifstream in(path_.c_str());
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        size_t i = 0;
+        while ((i = text.find('"', i)) != std::string::npos) {
+            std::string key;
+            for (++i; i < text.size() && text[i] != '"'; ++i) {
+                if (text[i] == '\\' && i + 1 < text.size())
+                    ++i;
+                key += text[i];
+            }
+            i = text.find(':', i);
+            if (i == std::string::npos)
+                break;
+            char* end = nullptr;
+            double ns = std::strtod(text.c_str() + i + 1, &end);
+            if (end != text.c_str() + i + 1)
+                entries[key] = ns;
+            i = end - text.c_str();
+        }
+        return entries;
+    }
+
+    std::string path_;
+    bool update_;
+};
+
+struct Percent {
+    double value;
+};
+
+constexpr Percent percent(double value) {
+    return Percent{ value };
+}
+
+inline std::ostream& operator<<(std::ostream& o, Percent const& p) {
+    return o << p.value << "%";
+}
+
+/*
+ * the timing of a callable must not exceed the baseline stored under key
+ * by more than the tolerance. Timings are the mean of a number of runs,
+ * after dropping the fastest and slowest fifth, so a few preempted or
+ * unusually lucky runs don't skew the result. With no stored timing, or
+ * in update mode, the measured one is recorded and the check passes.
+ */
+struct BaselineCheck {
+    std::string key;
+    Percent tolerance;
+    BaselineFile file;
+    size_t runs;
+    size_t warmup;
+};
+
+// a timing, and the stored one it was compared with, if there was one
+struct BaselineTiming {
+    double measured;
+    bool compared;
+    double baseline;
+};
+
+// the timing of a match is kept for the failure report in a LastMatch
+// slot of the calling thread, so the matcher itself stays immutable
+struct NoSlowerThanBaseline_ {
+protected:
+    template<typename F>
+    bool matches(BaselineCheck const& check, F const& callable) const {
+        BaselineTiming timing = time(check, callable);
+        LastMatch<BaselineTiming>::record(&check, &callable, timing);
+
+        if (!timing.compared)
+            return check.file.record(check.key, timing.measured);
+        return timing.measured <= timing.baseline * (1 + check.tolerance.value / 100);
+    }
+
+    void describe(std::ostream& o, BaselineCheck const& check) const {
+        o << "a callable no more than " << check.tolerance << " slower than baseline \""
+          << check.key << "\" in " << check.file.path();
+    }
+
+    // the timing made by matches(), or a new one if there is none
+    template<typename F>
+    void describeMismatch(std::ostream& o, BaselineCheck const& check, F const& callable) const {
+        BaselineTiming const* recorded = LastMatch<BaselineTiming>::find(&check, &callable);
+        BaselineTiming timing = recorded ? *recorded : time(check, callable);
+        o << "a trimmed mean of ";
+        print_duration(o, uint64_t(timing.measured));
+        if (!timing.compared) {
+            o << ", which couldn't be recorded";
+            return;
+        }
+        std::streamsize precision = o.precision(3);
+        o << " over " << check.runs << " runs, ";
+        if (timing.baseline > 0)
+            o << 100 * (timing.measured / timing.baseline - 1) << "% slower than ";
+        else
+            o << "slower than ";
+        o.precision(precision);
+        print_duration(o, uint64_t(timing.baseline));
+    }
+
+private:
+    // measures the callable and looks up its baseline, unless updating it
+    template<typename F>
+    static BaselineTiming time(BaselineCheck const& check, F const& callable) {
+        BaselineTiming timing = { trimmed_mean(check, callable), false, 0 };
+        if (!check.file.updating())
+            timing.compared = check.file.lookup(check.key, timing.baseline);
+        return timing;
+    }
+
+    template<typename F>
+    static double trimmed_mean(BaselineCheck const& check, F const& callable) {
+        typedef std::chrono::steady_clock clock;
+
+        for (size_t i = 0; i < check.warmup; ++i)
+            callable();
+
+        std::vector<uint64_t> times(check.runs);
+        for (auto& t : times) {
+            auto start = clock::now();
+            callable();
+            t = to_nanoseconds(clock::now() - start);
+        }
+
+        std::sort(times.begin(), times.end());
+        size_t trim = times.size() / 5;
+        auto first = times.begin() + trim, last = times.end() - trim;
+        if (first == last)
+            return 0;
+        double sum = 0;
+        for (auto it = first; it != last; ++it)
+            sum += *it;
+        return sum / (last - first);
+    }
+};
+
+using NoSlowerThanBaseline = Matcher<NoSlowerThanBaseline_,BaselineCheck>;
+
+inline NoSlowerThanBaseline noSlowerThanBaseline(std::string const& key, Percent tolerance,
+                                                 BaselineFile const& file = BaselineFile::fromEnvironment(),
+                                                 size_t runs = 31, size_t warmup = 5) {
+    return NoSlowerThanBaseline(BaselineCheck{ key, tolerance, file, runs, warmup });
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_BASELINE_H_
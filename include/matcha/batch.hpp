@@ -0,0 +1,254 @@
+/* vim: set sw=4 ts=4 et : */
+/* batch.hpp: parallel evaluation of a matcher over a batch of records
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_BATCH_H_
+#define _MATCHA_BATCH_H_
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * outcome of matching every record of a batch: one bit per record
+ * (set when it matched) and a summary of the failures
+ */
+class BatchResult {
+public:
+    explicit BatchResult(size_t size, size_t samples = 0)
+        : size_(size), failures_(0), firstFailure_(size), bits_((size + 63) / 64, 0),
+          sample_(samples)
+    { }
+
+    size_t size() const { return size_; }
+    size_t failures() const { return failures_; }
+
+    // index of the first record that didn't match, or size() if all did
+    size_t firstFailure() const { return firstFailure_; }
+
+    double failureRate() const {
+        return size_ ? double(failures_) / size_ : 0.0;
+    }
+
+    bool passed(size_t i) const {
+        return (bits_[i / 64] >> (i % 64)) & 1;
+    }
+
+    std::vector<uint64_t> const& bitmap() const { return bits_; }
+
+    // in collect mode, the indices of a uniform sample of the failed records
+    std::vector<size_t> sampledFailures() const {
+        std::vector<size_t> indices(sample_.items());
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, BatchResult const& r) {
+        o << r.size_ << " records, " << r.failures_ << " failed";
+        if (r.failures_)
+            o << " (" << 100.0 * r.failureRate() << "%), first at #" << r.firstFailure_;
+
+        auto sample = r.sampledFailures();
+        for (size_t i = 0; i < sample.size(); ++i)
+            o << (i ? ", #" : ", e.g. #") << sample[i];
+        return o;
+    }
+
+private:
+    friend class BatchRunner;
+
+    size_t size_;
+    size_t failures_;
+    size_t firstFailure_;
+    std::vector<uint64_t> bits_;
+    Reservoir<size_t> sample_;
+};
+
+/*
+ * evaluates a matcher over a random-access range of records on a pool of
+ * threads. Each thread starts with an equal share of the index space and
+ * works through it in blocks; a thread that runs out steals half of the
+ * work left to another one. Splits fall on 64-record boundaries, so every
+ * word of the result bitmap is written by a single thread.
+ *
+ * If the matcher (or reading a record) throws, the other threads stop at
+ * their next block and the first exception is rethrown by run().
+ */
+class BatchRunner {
+public:
+    explicit BatchRunner(unsigned threads = std::thread::hardware_concurrency())
+        : threads_(threads ? threads : 1)
+    { }
+
+    template<class Range, class M>
+    BatchResult run(Range const& records, M const& matcher, Collect mode = Collect{ 0 }) const {
+        typedef decltype(std::begin(records)) iterator;
+        static_assert(std::is_base_of<std::random_access_iterator_tag,
+                          typename std::iterator_traits<iterator>::iterator_category>::value,
+                      "batch validation requires a random-access range");
+
+        iterator first = std::begin(records);
+        size_t size = std::distance(first, std::end(records));
+        BatchResult result(size, mode.samples);
+
+        size_t nworkers = std::min<size_t>(threads_, (size + grain - 1) / grain);
+        if (nworkers == 0)
+            return result;
+
+        std::vector<Worker> workers(nworkers);
+        size_t share = (size / nworkers) / word * word;
+        for (size_t i = 0; i < nworkers; ++i) {
+            workers[i].lo = i * share;
+            workers[i].hi = i + 1 == nworkers ? size : (i + 1) * share;
+        }
+
+        std::atomic<bool> stop(false);
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto work = [&](size_t self) {
+            Worker& me = workers[self];
+            size_t failures = 0, firstFailure = size;
+            Reservoir<size_t> sample(mode.samples, self + 1);
+            size_t lo, hi;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!take(me, lo, hi)) {
+                    if (!steal(workers, self))
+                        break;
+                    continue;
+                }
+                for (size_t w = lo; w < hi; w += word) {
+                    uint64_t bits = 0;
+                    size_t end = std::min(w + word, hi);
+                    for (size_t i = w; i < end; ++i) {
+                        if (matcher.matches(first[i]))
+                            bits |= uint64_t(1) << (i - w);
+                        else {
+                            ++failures;
+                            firstFailure = std::min(firstFailure, i);
+                            if (mode.samples)
+                                sample.add(i);
+                        }
+                    }
+                    result.bits_[w / word] = bits;
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(me.lock);
+            me.failures = failures;
+            me.firstFailure = firstFailure;
+            me.sample = std::move(sample);
+        };
+
+        auto guarded = [&](size_t self) {
+            try {
+                work(self);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error)
+                    error = std::current_exception();
+                stop.store(true, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < nworkers; ++i)
+            pool.emplace_back(guarded, i);
+        guarded(0);
+        for (auto& t : pool)
+            t.join();
+        if (error)
+            std::rethrow_exception(error);
+
+        for (auto const& w : workers) {
+            result.failures_ += w.failures;
+            result.firstFailure_ = std::min(result.firstFailure_, w.firstFailure);
+            result.sample_.merge(w.sample);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t word = 64;
+    static constexpr size_t grain = 16 * word;
+
+    // the [lo, hi) range of records still to be checked by a thread
+    struct Worker {
+        Worker() : lo(0), hi(0), failures(0), firstFailure(0), sample(0)
+        { }
+
+        std::mutex lock;
+        size_t lo;
+        size_t hi;
+        size_t failures;
+        size_t firstFailure;
+        Reservoir<size_t> sample;
+        char padding[64];
+    };
+
+    // the next block of the worker's own range
+    static bool take(Worker& me, size_t& lo, size_t& hi) {
+        std::lock_guard<std::mutex> guard(me.lock);
+        if (me.lo == me.hi)
+            return false;
+        lo = me.lo;
+        hi = std::min(me.lo + grain, me.hi);
+        me.lo = hi;
+        return true;
+    }
+
+    // moves half of someone else's range (or all of it, if small) to ours
+    static bool steal(std::vector<Worker>& workers, size_t self) {
+        for (size_t k = 1; k < workers.size(); ++k) {
+            Worker& victim = workers[(self + k) % workers.size()];
+            size_t lo, hi;
+            {
+                std::lock_guard<std::mutex> guard(victim.lock);
+                size_t left = victim.hi - victim.lo;
+                if (!left)
+                    continue;
+                hi = victim.hi;
+                lo = left <= grain ? victim.lo : victim.lo + (left / 2) / word * word;
+                victim.hi = lo;
+            }
+            Worker& me = workers[self];
+            std::lock_guard<std::mutex> guard(me.lock);
+            me.lo = lo;
+            me.hi = hi;
+            return true;
+        }
+        return false;
+    }
+
+    unsigned threads_;
+};
+
+template<class Range, class M>
+BatchResult validateBatch(Range const& records, M const& matcher, Collect mode = Collect{ 0 }) {
+    return BatchRunner().run(records, matcher, mode);
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_BATCH_H_
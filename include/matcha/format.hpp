@@ -0,0 +1,246 @@
+/* vim: set sw=4 ts=4 et : */
+/* format.hpp: fast formatting of numbers and messages
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_FORMAT_H_
+#define _MATCHA_FORMAT_H_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <locale>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+namespace matcha {
+
+// arithmetic types printed as numbers: characters and bools aren't (nor
+// any integer wider than long long)
+template<typename T>
+struct is_number : std::integral_constant<bool,
+    std::is_arithmetic<T>::value
+    && (std::is_floating_point<T>::value || sizeof(T) <= sizeof(long long))
+    && !std::is_same<T,bool>::value
+    && !std::is_same<T,char>::value
+    && !std::is_same<T,signed char>::value
+    && !std::is_same<T,unsigned char>::value
+    && !std::is_same<T,wchar_t>::value
+    && !std::is_same<T,char16_t>::value
+    && !std::is_same<T,char32_t>::value>
+{ };
+
+// room for any number format_number writes
+static constexpr size_t max_number_length = 128;
+
+// writes the digits of v ending right before end, and returns where they start
+inline char* format_digits(char* end, unsigned long long v) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    while (v >= 100) {
+        unsigned i = unsigned(v % 100) * 2;
+        v /= 100;
+        *--end = pairs[i + 1];
+        *--end = pairs[i];
+    }
+    if (v >= 10) {
+        unsigned i = unsigned(v) * 2;
+        *--end = pairs[i + 1];
+        *--end = pairs[i];
+    }
+    else
+        *--end = char('0' + v);
+    return end;
+}
+
+/*
+ * formats a number the way an ostream with default flags and the given
+ * precision does (printf's %d and %g, in the "C" locale), into a buffer of
+ * max_number_length characters. Returns the number of characters written.
+ */
+template<typename T>
+typename std::enable_if<is_number<T>::value && std::is_integral<T>::value, size_t>::type
+format_number(char* buf, T value, int = 6) {
+    char tmp[24];
+    char* end = tmp + sizeof tmp;
+    bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ULL - static_cast<unsigned long long>(value)
+                                            : static_cast<unsigned long long>(value);
+    char* begin = format_digits(end, magnitude);
+    if (negative)
+        *--begin = '-';
+    std::memcpy(buf, begin, end - begin);
+    return end - begin;
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+format_number(char* buf, T value, int precision = 6) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto result = std::to_chars(buf, buf + max_number_length, value, std::chars_format::general, precision);
+    return result.ptr - buf;
+#else
+    int n = std::is_same<T,long double>::value
+        ? std::snprintf(buf, max_number_length, "%.*Lg", precision, static_cast<long double>(value))
+        : std::snprintf(buf, max_number_length, "%.*g", precision, static_cast<double>(value));
+    return n < 0 ? 0 : std::min<size_t>(n, max_number_length - 1);
+#endif
+}
+
+/*
+ * prints a number to an ostream, bypassing the locale-aware num_put facet
+ * when the stream is in its default state (decimal, no width, no sign or
+ * point forced, the "C" locale), which is all but always the case.
+ */
+template<typename T>
+typename std::enable_if<is_number<T>::value, void>::type
+print_number(std::ostream& o, T value) {
+    const std::ios_base::fmtflags custom = std::ios_base::oct | std::ios_base::hex
+        | std::ios_base::floatfield | std::ios_base::showpos | std::ios_base::showbase
+        | std::ios_base::showpoint | std::ios_base::uppercase;
+
+    if ((o.flags() & custom) || o.width() || o.precision() > 40 || o.getloc() != std::locale::classic()) {
+        o << value;
+        return;
+    }
+    char buf[max_number_length];
+    o.write(buf, format_number(buf, value, int(o.precision())));
+}
+
+/*
+ * append-only character buffer: text and numbers are copied or formatted
+ * straight into it, with no stream state, locale or virtual calls. The
+ * first 256 characters are stored inline.
+ */
+class FormatBuffer {
+public:
+    FormatBuffer() : data_(local_), size_(0), capacity_(sizeof local_)
+    { }
+
+    FormatBuffer(FormatBuffer const&) = delete;
+    FormatBuffer& operator=(FormatBuffer const&) = delete;
+
+    ~FormatBuffer() {
+        if (data_ != local_)
+            delete[] data_;
+    }
+
+    FormatBuffer& append(const char* s, size_t n) {
+        if (size_ + n > capacity_)
+            grow(size_ + n);
+        std::memcpy(data_ + size_, s, n);
+        size_ += n;
+        return *this;
+    }
+
+    FormatBuffer& operator<<(char c) {
+        return append(&c, 1);
+    }
+
+    FormatBuffer& operator<<(const char* s) {
+        return append(s, std::strlen(s));
+    }
+
+    FormatBuffer& operator<<(std::string const& s) {
+        return append(s.data(), s.size());
+    }
+
+    FormatBuffer& operator<<(bool b) {
+        return *this << (b ? '1' : '0');
+    }
+
+    template<typename T>
+    typename std::enable_if<is_number<T>::value, FormatBuffer&>::type
+    operator<<(T value) {
+        if (size_ + max_number_length > capacity_)
+            grow(size_ + max_number_length);
+        size_ += format_number(data_ + size_, value);
+        return *this;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string str() const { return std::string(data_, size_); }
+    void clear() { size_ = 0; }
+
+    friend std::ostream& operator<<(std::ostream& o, FormatBuffer const& buffer) {
+        return o.write(buffer.data_, buffer.size_);
+    }
+
+private:
+    void grow(size_t needed) {
+        size_t capacity = std::max(needed, 2 * capacity_);
+        char* data = new char[capacity];
+        std::memcpy(data, data_, size_);
+        if (data_ != local_)
+            delete[] data_;
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    char local_[256];
+    char* data_;
+    size_t size_;
+    size_t capacity_;
+};
+
+// the ostream adapter: anything written to the stream lands in the buffer
+class FormatStreambuf : public std::streambuf {
+public:
+    explicit FormatStreambuf(FormatBuffer& buffer) : buffer_(buffer)
+    { }
+
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        buffer_.append(s, size_t(n));
+        return n;
+    }
+
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            buffer_ << traits_type::to_char_type(c);
+        return traits_type::not_eof(c);
+    }
+
+private:
+    FormatBuffer& buffer_;
+};
+
+// an ostream writing into a FormatBuffer, for describe() and operator<<
+class FormatStream : public std::ostream {
+public:
+    explicit FormatStream(FormatBuffer& buffer) : std::ostream(nullptr), buf_(buffer)
+    {
+        rdbuf(&buf_);
+    }
+
+private:
+    FormatStreambuf buf_;
+};
+
+} // namespace matcha
+
+#endif // _MATCHA_FORMAT_H_
@@ -0,0 +1,297 @@
+/* vim: set sw=4 ts=4 et : */
+/* incremental.hpp: matching containers that only grow
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_INCREMENTAL_H_
+#define _MATCHA_INCREMENTAL_H_
+
+#include <memory>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * an iterator to the last item verified in a container without random
+ * access, so an update doesn't walk the verified items again. Appending
+ * to a std::list keeps it valid. It's only trusted for the container it
+ * was taken from, after as many items as it was taken at. Copies start
+ * out empty.
+ */
+class VerifiedEnd {
+public:
+    VerifiedEnd() : owner_(nullptr), count_(0)
+    { }
+
+    VerifiedEnd(VerifiedEnd const&) : owner_(nullptr), count_(0)
+    { }
+
+    VerifiedEnd& operator=(VerifiedEnd const&) {
+        clear();
+        return *this;
+    }
+
+    template<typename C, typename It>
+    void remember(C const& cont, It last, size_t count) {
+        if (!dynamic_cast<At<It>*>(at_.get()))
+            at_.reset(new At<It>(last));
+        else
+            static_cast<At<It>*>(at_.get())->last = last;
+        owner_ = &cont;
+        count_ = count;
+    }
+
+    // the last of count items verified in cont, or null if unknown
+    template<typename C, typename It>
+    It const* find(C const& cont, size_t count) const {
+        if (owner_ != &cont || count_ != count)
+            return nullptr;
+        At<It> const* at = dynamic_cast<At<It> const*>(at_.get());
+        return at ? &at->last : nullptr;
+    }
+
+    void clear() {
+        owner_ = nullptr;
+        count_ = 0;
+    }
+
+private:
+    struct Position {
+        virtual ~Position() { }
+    };
+
+    template<typename It>
+    struct At : Position {
+        explicit At(It it) : last(it)
+        { }
+        It last;
+    };
+
+    void const* owner_;
+    size_t count_;
+    std::unique_ptr<Position> at_;
+};
+
+/*
+ * an item matcher (everyItem, atLeast, atMost, exactly) over a container
+ * that is only ever appended to, checking each item once, e.g.
+ *
+ *   auto allValid = incremental(everyItem(isValid()));
+ *   for (auto& batch : batches) {
+ *       append(results, run(batch));
+ *       assertThat(results, allValid);   // or allValid.update(results)
+ *   }
+ *
+ * It remembers how many items it has verified, the first one to fail and
+ * how many matched, and on each update only checks the items appended
+ * since. Once the outcome can't change any more (an item failed
+ * everyItem, too many matched atMost, enough matched atLeast) it stops
+ * looking at items at all. A container shorter than the last time is
+ * checked again from the start. Random-access containers are resumed by
+ * index; others (std::list) from an iterator kept to the last verified
+ * item, valid as long as appending doesn't invalidate it.
+ *
+ * The handle works with assertThat, but can't be composed with anyOf or
+ * allOf; each handle should follow a single container.
+ */
+template<typename M>
+class Incremental {
+public:
+    static constexpr size_t none = size_t(-1);
+
+    explicit Incremental(M const& matcher) : matcher_(matcher)
+    {
+        restart();
+    }
+
+    // checks the items appended since the last update, true if the whole container matches
+    template<typename C>
+    bool update(C const& cont) const {
+        size_t size = range_size(cont);
+        if (size < verified_)
+            restart();
+        if (!settled_) {
+            auto it = unverified(cont);
+            auto const last = std::end(cont);
+            if (it != last) {
+                auto checked = it;
+                for (; it != last && !settled_; ++it, ++verified_) {
+                    step(matcher_.expected(), *it);
+                    checked = it;
+                }
+                remember(cont, checked);
+            }
+        }
+        verified_ = size;
+        return settled_ ? result_ : outcome(matcher_.expected());
+    }
+
+    template<typename C>
+    bool matches(C const& cont) const {
+        return update(cont);
+    }
+
+    // forgets what was verified, e.g. to follow another container
+    void reset() {
+        restart();
+    }
+
+    // the number of items verified, or known not to matter
+    size_t verified() const { return verified_; }
+
+    // the number of items matching the item matcher
+    size_t count() const { return count_; }
+
+    // the position of the first item failing everyItem, or none
+    size_t firstFailure() const { return firstFailure_; }
+
+    template<typename C>
+    void describeMismatch(std::ostream& o, C const& cont) const {
+        print_mismatch(o, matcher_.expected(), cont);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Incremental const& inc) {
+        return o << inc.matcher_;
+    }
+
+private:
+    void restart() const {
+        verifiedEnd_.clear();
+        verified_ = 0;
+        count_ = 0;
+        firstFailure_ = none;
+        settled_ = false;
+        result_ = false;
+    }
+
+    // the first item not verified yet
+    template<typename C>
+    auto unverified(C const& cont) const -> decltype(std::begin(cont)) {
+        typedef decltype(std::begin(cont)) Iterator;
+        return unverified(cont, typename std::iterator_traits<Iterator>::iterator_category());
+    }
+
+    template<typename C>
+    auto unverified(C const& cont, std::random_access_iterator_tag) const -> decltype(std::begin(cont)) {
+        return std::begin(cont) + verified_;
+    }
+
+    template<typename C>
+    auto unverified(C const& cont, std::input_iterator_tag) const -> decltype(std::begin(cont)) {
+        typedef decltype(std::begin(cont)) Iterator;
+        if (verified_ == 0)
+            return std::begin(cont);
+        if (Iterator const* last = verifiedEnd_.find<C, Iterator>(cont, verified_))
+            return std::next(*last);
+        return std::next(std::begin(cont), verified_);
+    }
+
+    template<typename C, typename It>
+    void remember(C const& cont, It last) const {
+        typedef typename std::iterator_traits<It>::iterator_category Category;
+        if (!std::is_base_of<std::random_access_iterator_tag, Category>::value)
+            verifiedEnd_.remember(cont, last, verified_);
+    }
+
+    void settle(bool result) const {
+        settled_ = true;
+        result_ = result;
+    }
+
+    template<typename T, typename Policy, typename Item>
+    void step(Matcher<Policy,T> const& itemMatcher, Item const& item) const {
+        if (itemMatcher.matches(item))
+            ++count_;
+        else {
+            firstFailure_ = verified_;
+            settle(false);
+        }
+    }
+
+    template<typename Q, typename Item>
+    void step(Collecting<Q> const& expected, Item const& item) const {
+        step(expected.matcher, item);
+    }
+
+    template<typename Q, typename Item>
+    void step(Quantified<Q> const& expected, Item const& item) const {
+        if (!expected.matcher.matches(item))
+            return;
+        if (++count_ > expected.max)
+            settle(false);
+        else if (count_ >= expected.min && expected.max == expected.unbounded)
+            settle(true);
+    }
+
+    template<typename E>
+    bool outcome(E const&) const {
+        return true;
+    }
+
+    template<typename Q>
+    bool outcome(Quantified<Q> const& expected) const {
+        return count_ >= expected.min && count_ <= expected.max;
+    }
+
+    template<typename E, typename C>
+    void print_mismatch(std::ostream& o, E const&, C const& cont) const {
+        if (firstFailure_ == none || firstFailure_ >= range_size(cont)) {
+            o << "no failing item among " << verified_;
+            return;
+        }
+        auto it = std::begin(cont);
+        std::advance(it, firstFailure_);
+        o << "item #" << firstFailure_ << " of " << verified_ << ": " << *it;
+    }
+
+    // the collecting matcher already reports a sample of the failures
+    template<typename Q, typename C>
+    void print_mismatch(std::ostream& o, Collecting<Q> const&, C const& cont) const {
+        matcher_.describeMismatch(o, cont);
+    }
+
+    template<typename Q, typename C>
+    void print_mismatch(std::ostream& o, Quantified<Q> const&, C const&) const {
+        o << count_ << " of " << verified_ << " items matched";
+    }
+
+    M matcher_;
+    mutable size_t verified_;
+    mutable size_t count_;
+    mutable size_t firstFailure_;
+    mutable bool settled_;
+    mutable bool result_;
+    mutable VerifiedEnd verifiedEnd_;
+};
+
+template<typename T, typename Policy>
+Incremental<IsContaining<Matcher<Policy,T>>> incremental(IsContaining<Matcher<Policy,T>> const& matcher) {
+    return Incremental<IsContaining<Matcher<Policy,T>>>(matcher);
+}
+
+template<typename M>
+Incremental<IsContaining<Collecting<M>>> incremental(IsContaining<Collecting<M>> const& matcher) {
+    return Incremental<IsContaining<Collecting<M>>>(matcher);
+}
+
+template<typename M>
+Incremental<IsContaining<Quantified<M>>> incremental(IsContaining<Quantified<M>> const& matcher) {
+    return Incremental<IsContaining<Quantified<M>>>(matcher);
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_INCREMENTAL_H_
@@ -0,0 +1,201 @@
+/* vim: set sw=4 ts=4 et : */
+/* latency.hpp: latency budgets for callables
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_LATENCY_H_
+#define _MATCHA_LATENCY_H_
+
+#include <chrono>
+#include <cstdint>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * fixed-size log-linear histogram of durations in nanoseconds: every power
+ * of two is split in 8 buckets, so a percentile read from it is at most
+ * 12.5% above the true value. The maximum is kept exactly.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram() : count_(0), max_(0), buckets_()
+    { }
+
+    void add(uint64_t ns) {
+        ++buckets_[bucket(ns)];
+        ++count_;
+        max_ = std::max(max_, ns);
+    }
+
+    size_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+
+    // upper bound of the bucket holding the q-th quantile, q in [0, 1]
+    uint64_t percentile(double q) const {
+        if (!count_)
+            return 0;
+        size_t rank = std::max<size_t>(1, size_t(q * count_ + 0.5));
+        size_t seen = 0;
+        for (size_t i = 0; i < nbuckets; ++i) {
+            seen += buckets_[i];
+            if (seen >= rank)
+                return std::min(upper(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr unsigned subBits = 3;
+    // exact values below 2 << subBits, then 1 << subBits buckets for each
+    // power of two from 2^(subBits + 1) up to 2^63
+    static constexpr size_t nbuckets = (64 - subBits + 1) << subBits;
+
+    static unsigned msb(uint64_t x) {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(x);
+#else
+        unsigned n = 0;
+        while (x >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    static size_t bucket(uint64_t ns) {
+        if (ns < (2 << subBits))
+            return ns;
+        unsigned shift = msb(ns) - subBits;
+        return (shift + 1) * (1 << subBits) + ((ns >> shift) & ((1 << subBits) - 1));
+    }
+
+    static uint64_t upper(size_t i) {
+        if (i < (2 << subBits))
+            return i;
+        unsigned shift = i / (1 << subBits) - 1;
+        uint64_t sub = i % (1 << subBits) + (1 << subBits);
+        return ((sub + 1) << shift) - 1;
+    }
+
+    size_t count_;
+    uint64_t max_;
+    uint32_t buckets_[nbuckets];
+};
+
+// prints a duration with a unit that keeps it readable, e.g. 1.25ms
+inline void print_duration(std::ostream& o, uint64_t ns) {
+    std::streamsize precision = o.precision(3);
+    if (ns < 1000)
+        o << ns << "ns";
+    else if (ns < 1000000)
+        o << ns / 1e3 << "us";
+    else if (ns < 1000000000)
+        o << ns / 1e6 << "ms";
+    else
+        o << ns / 1e9 << "s";
+    o.precision(precision);
+}
+
+/*
+ * a limit on one statistic of the latency of a callable, measured over a
+ * number of runs once the warmup runs are done
+ */
+struct LatencyBudget {
+    enum Statistic { Max, P99 };
+
+    Statistic statistic;
+    uint64_t limit;
+    size_t runs;
+    size_t warmup;
+};
+
+// the histogram of a match is kept for the failure report in a LastMatch
+// slot of the calling thread, so the matcher itself stays immutable
+struct Latency_ {
+protected:
+    template<typename F>
+    bool matches(LatencyBudget const& budget, F const& callable) const {
+        LatencyHistogram measured = measure(budget, callable);
+        bool passed = statistic(budget, measured) <= budget.limit;
+        LastMatch<LatencyHistogram>::record(&budget, &callable, measured);
+        return passed;
+    }
+
+    void describe(std::ostream& o, LatencyBudget const& budget) const {
+        o << (budget.statistic == LatencyBudget::Max ? "a callable completing within "
+                                                     : "a callable with a p99 latency below ");
+        print_duration(o, budget.limit);
+        o << " over " << budget.runs << (budget.runs == 1 ? " run" : " runs");
+    }
+
+    // the measurement made by matches(), or a new one if there is none
+    template<typename F>
+    void describeMismatch(std::ostream& o, LatencyBudget const& budget, F const& callable) const {
+        LatencyHistogram const* recorded = LastMatch<LatencyHistogram>::find(&budget, &callable);
+        LatencyHistogram const& h = recorded ? *recorded : measure(budget, callable);
+        o << "p50 = ";
+        print_duration(o, h.percentile(0.5));
+        o << ", p99 = ";
+        print_duration(o, h.percentile(0.99));
+        o << ", max = ";
+        print_duration(o, h.max());
+    }
+
+private:
+    template<typename F>
+    static LatencyHistogram measure(LatencyBudget const& budget, F const& callable) {
+        typedef std::chrono::steady_clock clock;
+
+        for (size_t i = 0; i < budget.warmup; ++i)
+            callable();
+
+        LatencyHistogram measured;
+        for (size_t i = 0; i < budget.runs; ++i) {
+            auto start = clock::now();
+            callable();
+            auto elapsed = clock::now() - start;
+            measured.add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+        return measured;
+    }
+
+    static uint64_t statistic(LatencyBudget const& budget, LatencyHistogram const& measured) {
+        return budget.statistic == LatencyBudget::Max ? measured.max()
+                                                      : measured.percentile(0.99);
+    }
+};
+
+using Latency = Matcher<Latency_,LatencyBudget>;
+
+template<typename Rep, typename Period>
+uint64_t to_nanoseconds(std::chrono::duration<Rep,Period> d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+// every one of the runs completes within the limit
+template<typename Rep, typename Period>
+Latency completesWithin(std::chrono::duration<Rep,Period> limit, size_t runs = 1, size_t warmup = 1) {
+    return Latency(LatencyBudget{ LatencyBudget::Max, to_nanoseconds(limit), runs, warmup });
+}
+
+template<typename Rep, typename Period>
+Latency hasP99Below(std::chrono::duration<Rep,Period> limit, size_t runs = 1000, size_t warmup = 10) {
+    return Latency(LatencyBudget{ LatencyBudget::P99, to_nanoseconds(limit), runs, warmup });
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_LATENCY_H_
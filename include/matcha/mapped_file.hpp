@@ -0,0 +1,200 @@
+/* vim: set sw=4 ts=4 et : */
+/* mapped_file.hpp: memory-mapped files as input for matchers
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_MAPPED_FILE_H_
+#define _MATCHA_MAPPED_FILE_H_
+
+#include <cerrno>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * read-only mapping of a whole file, exposed as a range of bytes.
+ * The kernel pages the file in as matchers walk through it, so nothing
+ * is ever copied onto the heap.
+ */
+class MappedFile {
+public:
+    typedef char value_type;
+    typedef const char* const_iterator;
+
+    explicit MappedFile(std::string const& path)
+        : path_(path), data_(nullptr), size_(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::system_error(errno, std::system_category(), path);
+
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), path);
+        }
+
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::system_category(), path);
+            }
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(MappedFile&& other)
+        : path_(std::move(other.path_)), data_(other.data_), size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile() {
+        if (data_)
+            ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+    std::string const& path() const { return path_; }
+
+    operator string_ref() const {
+        return string_ref(data_, size_);
+    }
+
+    // never dump the contents, the file may be gigabytes long
+    friend std::ostream& operator<<(std::ostream& o, MappedFile const& file) {
+        return o << "<file \"" << file.path_ << "\", " << file.size_ << " bytes>";
+    }
+
+private:
+    std::string path_;
+    const char* data_;
+    size_t size_;
+};
+
+// forward iterator yielding each line of a character range, without the '\n'
+class LineIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef string_ref value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const string_ref* pointer;
+    typedef string_ref reference;
+
+    LineIterator() : pos_(nullptr), end_(nullptr), eol_(nullptr)
+    { }
+
+    LineIterator(const char* pos, const char* end) : pos_(pos), end_(end)
+    {
+        find_eol();
+    }
+
+    string_ref operator*() const {
+        return string_ref(pos_, eol_ - pos_);
+    }
+
+    LineIterator& operator++() {
+        pos_ = eol_ == end_ ? end_ : eol_ + 1;
+        find_eol();
+        return *this;
+    }
+
+    LineIterator operator++(int) {
+        LineIterator tmp(*this);
+        ++*this;
+        return tmp;
+    }
+
+    friend bool operator==(LineIterator const& a, LineIterator const& b) {
+        return a.pos_ == b.pos_;
+    }
+
+    friend bool operator!=(LineIterator const& a, LineIterator const& b) {
+        return a.pos_ != b.pos_;
+    }
+
+private:
+    void find_eol() {
+        if (pos_ == end_) {
+            eol_ = end_;
+            return;
+        }
+        auto p = static_cast<const char*>(std::memchr(pos_, '\n', end_ - pos_));
+        eol_ = p ? p : end_;
+    }
+
+    const char* pos_;
+    const char* end_;
+    const char* eol_;
+};
+
+// the lines of a mapped file, as string_ref views into the mapping
+class LineRange {
+public:
+    typedef string_ref value_type;
+    typedef LineIterator const_iterator;
+
+    explicit LineRange(MappedFile&& file) : file_(std::move(file))
+    { }
+
+    const_iterator begin() const {
+        return const_iterator(file_.begin(), file_.end());
+    }
+
+    const_iterator end() const {
+        return const_iterator(file_.end(), file_.end());
+    }
+
+    bool empty() const { return file_.empty(); }
+
+    friend std::ostream& operator<<(std::ostream& o, LineRange const& lines) {
+        return o << "lines of " << lines.file_;
+    }
+
+private:
+    MappedFile file_;
+};
+
+inline MappedFile mappedFile(std::string const& path) {
+    return MappedFile(path);
+}
+
+inline LineRange linesOf(std::string const& path) {
+    return LineRange(MappedFile(path));
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_MAPPED_FILE_H_
@@ -26,15 +26,24 @@
 #include <iterator>
 #include <functional>
 #include <set>
+#include <map>
+#include <list>
+#include <deque>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <tuple>
 #include <array>
+#include <memory>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <cctype>
 #include <type_traits>
 #include <regex>
+#include <random>
 #include "prettyprint.hpp"
+#include "format.hpp"
 
 #if defined(MATCHA_GTEST)
 #include "gtest/gtest.h"
@@ -122,6 +131,67 @@ struct is_same<T, First, Rest...>
       >
 { };
 
+// SFINAE type trait to detect whether T can be traversed with begin/end,
+// and if so, the type of its elements. Unlike pretty_print::is_container it
+// doesn't require T to be a container, single-pass input ranges will do.
+
+template<typename T, typename = void>
+struct range_value
+{ };
+
+template<typename T>
+struct range_value<T,
+    typename std::enable_if<
+        true,
+        decltype((std::begin(std::declval<T const&>()) != std::end(std::declval<T const&>())), (void)0)
+        >::type
+    >
+{
+    typedef typename std::decay<decltype(*std::begin(std::declval<T const&>()))>::type type;
+};
+
+template<typename T, typename = void>
+struct is_range : std::false_type
+{ };
+
+template<typename T>
+struct is_range<T,
+    typename std::enable_if<
+        true,
+        decltype(std::declval<typename range_value<T>::type>(), (void)0)
+        >::type
+    > : std::true_type
+{ };
+
+// SFINAE type trait to detect whether T has a (constant-time) size() member.
+
+template<typename T, typename = void>
+struct has_size : std::false_type
+{ };
+
+template<typename T>
+struct has_size<T,
+    typename std::enable_if<
+        true,
+        decltype(std::declval<T const&>().size(), (void)0)
+        >::type
+    > : std::true_type
+{ };
+
+// number of elements in a range, counting them only if there's no size()
+
+template<typename C>
+typename std::enable_if<has_size<C>::value, size_t>::type
+range_size(C const& cont) {
+    return cont.size();
+}
+
+template<typename C>
+typename std::enable_if<!has_size<C>::value, size_t>::type
+range_size(C const& cont) {
+    return std::distance(std::begin(cont), std::end(cont));
+}
+
 // templated operator<< when type T is not std container (using prettyprint)
 // and user-defined insertion operator is not provided
 
@@ -137,6 +207,91 @@ operator<<(std::basic_ostream<TChar, TCharTraits> &os, const T &)
     return os;
 }
 
+// type trait to detect the standard containers and built-in arrays that
+// prettyprint.hpp prints as a sequence of items. Other ranges are left to
+// their own operator<<, if they have one.
+
+template<typename T>
+struct is_printed_container : std::false_type
+{ };
+
+template<typename T, size_t N>
+struct is_printed_container<T[N]> : ::pretty_print::is_container<T[N]>
+{ };
+
+template<typename T, size_t N>
+struct is_printed_container<std::array<T, N>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::vector<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::deque<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::list<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::set<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::multiset<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::unordered_set<Args...>> : std::true_type
+{ };
+
+template<typename... Args>
+struct is_printed_container<std::unordered_multiset<Args...>> : std::true_type
+{ };
+
+template<typename T>
+struct is_printed_container<std::valarray<T>> : std::true_type
+{ };
+
+// prints a value, numbers through the fast path of format.hpp. Standard
+// containers are laid out here with the delimiters of prettyprint.hpp, so
+// that the numbers they hold take the fast path as well.
+
+template<typename T>
+typename std::enable_if<is_number<T>::value, void>::type
+print_value(std::ostream& o, T const& value) {
+    print_number(o, value);
+}
+
+template<typename T>
+typename std::enable_if<!is_number<T>::value && !is_printed_container<T>::value, void>::type
+print_value(std::ostream& o, T const& value) {
+    o << value;
+}
+
+template<typename T>
+typename std::enable_if<is_printed_container<T>::value, void>::type
+print_value(std::ostream& o, T const& value) {
+    typedef ::pretty_print::delimiters<T, char> delimiters;
+    if (delimiters::values.prefix != NULL)
+        o << delimiters::values.prefix;
+    auto it = std::begin(value);
+    auto const last = std::end(value);
+    if (it != last) {
+        for (;;) {
+            print_value(o, *it);
+            if (++it == last)
+                break;
+            if (delimiters::values.delimiter != NULL)
+                o << delimiters::values.delimiter;
+        }
+    }
+    if (delimiters::values.postfix != NULL)
+        o << delimiters::values.postfix;
+}
+
 /*
  * character traits to provide case-insensitive comparison
  * http://www.gotw.ca/gotw/029.htm
@@ -177,14 +332,378 @@ std::ostream& operator<<(std::ostream& os, const ci_string& str)
     return os.write(str.data(), str.size());
 }
 
+/*
+ * non-owning view of a character sequence, so that string matchers can
+ * work on memory they don't own (e.g. mapped files) without copying it
+ */
+class string_ref {
+public:
+    typedef char value_type;
+    typedef const char* const_iterator;
+
+    constexpr string_ref() : data_(nullptr), size_(0)
+    { }
+
+    constexpr string_ref(const char* s, size_t n) : data_(s), size_(n)
+    { }
+
+    string_ref(const char* s) : data_(s), size_(std::strlen(s))
+    { }
+
+    string_ref(std::string const& s) : data_(s.data()), size_(s.size())
+    { }
+
+    constexpr const char* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr const_iterator begin() const { return data_; }
+    constexpr const_iterator end() const { return data_ + size_; }
+
+    size_t find(string_ref const& s) const {
+        auto it = std::search(begin(), end(), s.begin(), s.end());
+        return it == end() ? std::string::npos : size_t(it - begin());
+    }
+
+    std::string str() const {
+        return std::string(data_, size_);
+    }
+
+    friend bool operator==(string_ref const& a, string_ref const& b) {
+        return a.size_ == b.size_
+            && (a.size_ == 0 || !std::memcmp(a.data_, b.data_, a.size_));
+    }
+
+    friend bool operator<(string_ref const& a, string_ref const& b) {
+        int order = std::min(a.size_, b.size_) ? std::memcmp(a.data_, b.data_, std::min(a.size_, b.size_)) : 0;
+        return order < 0 || (order == 0 && a.size_ < b.size_);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, string_ref const& s) {
+        return os.write(s.data_, s.size_);
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+// non-owning view of a C-style array, the counterpart of string_ref
+template<typename T>
+class array_ref {
+public:
+    typedef T value_type;
+    typedef const T* const_iterator;
+
+    constexpr array_ref(const T* data, size_t n) : data_(data), size_(n)
+    { }
+
+    constexpr const T* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr const_iterator begin() const { return data_; }
+    constexpr const_iterator end() const { return data_ + size_; }
+
+    friend bool operator==(array_ref const& a, array_ref const& b) {
+        return a.size_ == b.size_ && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+private:
+    const T* data_;
+    size_t size_;
+};
+
+// views C-style arrays without copying them: character arrays as strings
+// (up to the terminating null), any other array as a range of elements
+
+template<size_t N>
+string_ref make_view(char const (&s)[N]) {
+    return string_ref(s);
+}
+
+template<typename T, size_t N>
+constexpr array_ref<T> make_view(T const (&a)[N]) {
+    return array_ref<T>(a, N);
+}
+
+/*
+ * string literal encoded in a type, so that string matchers built from it
+ * store nothing and compare against a compile-time length (which compilers
+ * expand into a few word compares). Build them with MATCHA_LIT("...").
+ */
+template<char... Cs>
+struct literal {
+    static constexpr size_t size = sizeof...(Cs);
+    static constexpr char value[sizeof...(Cs) + 1] = { Cs..., '\0' };
+
+    friend std::ostream& operator<<(std::ostream& os, literal const&) {
+        return os.write(value, size);
+    }
+};
+
+template<char... Cs>
+constexpr char literal<Cs...>::value[sizeof...(Cs) + 1];
+
+// appends characters to a literal up to the first '\0'
+template<typename L, char... Cs>
+struct make_literal;
+
+template<char... Acc>
+struct make_literal<literal<Acc...>> {
+    typedef literal<Acc...> type;
+};
+
+template<char... Acc, char... Rest>
+struct make_literal<literal<Acc...>, '\0', Rest...> {
+    typedef literal<Acc...> type;
+};
+
+template<char... Acc, char C, char... Rest>
+struct make_literal<literal<Acc...>, C, Rest...>
+    : make_literal<literal<Acc..., C>, Rest...>
+{ };
+
+template<size_t N, typename L>
+struct checked_literal {
+    static_assert(N == L::size, "MATCHA_LIT takes up to 64 characters, with no embedded nulls");
+    typedef L type;
+};
+
+template<size_t N>
+constexpr char literal_char(char const (&s)[N], size_t i) {
+    return i < N ? s[i] : '\0';
+}
+
+#define MATCHA_LIT_CHARS_(s, i)                                             \
+    ::matcha::literal_char(s, i),     ::matcha::literal_char(s, i + 1),     \
+    ::matcha::literal_char(s, i + 2), ::matcha::literal_char(s, i + 3),     \
+    ::matcha::literal_char(s, i + 4), ::matcha::literal_char(s, i + 5),     \
+    ::matcha::literal_char(s, i + 6), ::matcha::literal_char(s, i + 7)
+
+#define MATCHA_LIT(s)                                                       \
+    ::matcha::checked_literal<sizeof(s) - 1,                                \
+        ::matcha::make_literal< ::matcha::literal<>,                        \
+            MATCHA_LIT_CHARS_(s, 0),  MATCHA_LIT_CHARS_(s, 8),              \
+            MATCHA_LIT_CHARS_(s, 16), MATCHA_LIT_CHARS_(s, 24),             \
+            MATCHA_LIT_CHARS_(s, 32), MATCHA_LIT_CHARS_(s, 40),             \
+            MATCHA_LIT_CHARS_(s, 48), MATCHA_LIT_CHARS_(s, 56)              \
+        >::type>::type()
+
+/*
+ * adapts a pair of input iterators (e.g. istream_iterator, or any generator
+ * or socket reader exposing an iterator interface) so that container matchers
+ * can consume it in a single pass. Elements are never stored, except for the
+ * first K of them, which are kept as a sample for the failure message.
+ */
+template<typename InputIt, size_t K = 8>
+class InputRange {
+public:
+    typedef typename std::iterator_traits<InputIt>::value_type value_type;
+
+    class const_iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef typename std::iterator_traits<InputIt>::value_type value_type;
+        typedef typename std::iterator_traits<InputIt>::difference_type difference_type;
+        typedef typename std::iterator_traits<InputIt>::pointer pointer;
+        typedef typename std::iterator_traits<InputIt>::reference reference;
+
+        const_iterator(InputIt it, InputRange const* range)
+            : it_(it), range_(range), index_(0)
+        { }
+
+        reference operator*() const {
+            reference item = *it_;
+            range_->record(index_, item);
+            return item;
+        }
+
+        const_iterator& operator++() {
+            ++it_;
+            ++index_;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator tmp(*this);
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const_iterator const& a, const_iterator const& b) {
+            return a.it_ == b.it_;
+        }
+
+        friend bool operator!=(const_iterator const& a, const_iterator const& b) {
+            return a.it_ != b.it_;
+        }
+
+    private:
+        InputIt it_;
+        InputRange const* range_;
+        size_t index_;
+    };
+
+    InputRange(InputIt first, InputIt last)
+        : first_(first), last_(last), seen_(0)
+    {
+        sample_.reserve(K);
+    }
+
+    const_iterator begin() const { return const_iterator(first_, this); }
+    const_iterator end() const { return const_iterator(last_, this); }
+
+    friend std::ostream& operator<<(std::ostream& o, InputRange const& range) {
+        if (!range.seen_)
+            return o << "<unread input range>";
+
+        o << "[";
+        for (size_t i = 0; i < range.sample_.size(); ++i)
+            o << (i ? ", " : "") << range.sample_[i];
+        if (range.seen_ > range.sample_.size())
+            o << ", ... (" << range.seen_ << " items read)";
+        return o << "]";
+    }
+
+private:
+    void record(size_t index, value_type const& item) const {
+        if (index < seen_)
+            return;
+        seen_ = index + 1;
+        if (sample_.size() < K)
+            sample_.push_back(item);
+    }
+
+    InputIt first_;
+    InputIt last_;
+    mutable size_t seen_;
+    mutable std::vector<value_type> sample_;
+};
+
+template<typename InputIt>
+InputRange<InputIt> range(InputIt first, InputIt last) {
+    return InputRange<InputIt>(first, last);
+}
+
+// the whitespace-separated values of type T read from an input stream
+template<typename T>
+InputRange<std::istream_iterator<T>> streamOf(std::istream& is) {
+    return InputRange<std::istream_iterator<T>>(std::istream_iterator<T>(is),
+                                                std::istream_iterator<T>());
+}
+
+/*
+ * uniform sample of at most `capacity` items out of a stream of unknown
+ * length (reservoir sampling), so that failures can be counted and a few
+ * of them shown without keeping every one in memory
+ */
+template<typename T>
+class Reservoir {
+public:
+    explicit Reservoir(size_t capacity, unsigned seed = 1)
+        : capacity_(capacity), seen_(0), rng_(seed)
+    {
+        items_.reserve(capacity);
+    }
+
+    void add(T const& item) {
+        ++seen_;
+        if (items_.size() < capacity_) {
+            items_.push_back(item);
+            return;
+        }
+        size_t j = std::uniform_int_distribution<size_t>(0, seen_ - 1)(rng_);
+        if (j < capacity_)
+            items_[j] = item;
+    }
+
+    // folds in a sample taken over a disjoint part of the stream
+    void merge(Reservoir const& other) {
+        std::vector<T> a(items_), b(other.items_);
+        size_t na = seen_, nb = other.seen_;
+
+        items_.clear();
+        while (items_.size() < capacity_ && (!a.empty() || !b.empty())) {
+            bool fromA = b.empty()
+                || (!a.empty() && std::uniform_int_distribution<size_t>(0, na + nb - 1)(rng_) < na);
+            std::vector<T>& from = fromA ? a : b;
+            size_t j = std::uniform_int_distribution<size_t>(0, from.size() - 1)(rng_);
+            items_.push_back(from[j]);
+            from[j] = from.back();
+            from.pop_back();
+            --(fromA ? na : nb);
+        }
+        seen_ += other.seen_;
+    }
+
+    size_t seen() const { return seen_; }
+    std::vector<T> const& items() const { return items_; }
+
+private:
+    size_t capacity_;
+    size_t seen_;
+    std::vector<T> items_;
+    std::minstd_rand rng_;
+};
+
+/*
+ * what the last match on this thread found out about an actual value,
+ * for describeMismatch to report without reading the value again (a
+ * single-pass range can't be) and without the matcher keeping state of
+ * its own. It is filed under the addresses of the expected and the actual
+ * values, which assertThat passes to both calls.
+ */
+template<typename Report>
+class LastMatch {
+public:
+    static void record(void const* expected, void const* actual, Report report) {
+        Slot& last = slot();
+        last.expected = expected;
+        last.actual = actual;
+        last.report = std::move(report);
+    }
+
+    // the report recorded for these values, or null
+    static Report const* find(void const* expected, void const* actual) {
+        Slot const& last = slot();
+        return last.expected == expected && last.actual == actual ? &last.report : nullptr;
+    }
+
+private:
+    struct Slot {
+        void const* expected;
+        void const* actual;
+        Report report;
+    };
+
+    static Slot& slot() {
+        static thread_local Slot last = { nullptr, nullptr, Report() };
+        return last;
+    }
+};
+
 template <typename T>
-std::string to_string(T const& val)
+typename std::enable_if<is_number<T>::value, std::string>::type
+to_string(T const& val)
 {
-    std::ostringstream out;
+    FormatBuffer out;
     out << val;
     return out.str();
 }
 
+template <typename T>
+typename std::enable_if<!is_number<T>::value, std::string>::type
+to_string(T const& val)
+{
+    FormatBuffer buffer;
+    FormatStream out(buffer);
+    out << val;
+    return buffer.str();
+}
+
+inline std::string to_string(std::string const& val)
+{
+    return val;
+}
+
 template<typename T>
 struct output_traits;
 
@@ -250,6 +769,14 @@ struct output_traits<boost::test_tools::predicate_result>
 
 #endif
 
+// the explanation of a failed assertion
+template<class T, class Matcher>
+void describeFailure(std::ostream& o, T const& actual, Matcher const& matcher) {
+    o << '\n' << "Expected: " << matcher << '\n' << "but got : ";
+    matcher.describeMismatch(o, actual);
+    o << '\n';
+}
+
 template<class Result, class T, class Matcher>
 typename output_traits<Result>::result_type
 assertResult(T const& actual, Matcher const& matcher) {
@@ -258,97 +785,376 @@ assertResult(T const& actual, Matcher const& matcher) {
     if (matcher.matches(actual))
         return output_traits<Result>::success();
 
-    output_traits<Result>::ostream(result)    << '\n'
-        << "Expected: " << to_string(matcher) << '\n'
-        << "but got : " << to_string(actual)  << '\n'; 
+    FormatBuffer buffer;
+    FormatStream message(buffer);
+    describeFailure(message, actual, matcher);
+    output_traits<Result>::ostream(result) << buffer;
 
     return result;
 }
 
-template<class MatcherPolicy, class ExpectedType = void>
-class Matcher : public MatcherPolicy {
+// the type a matcher stores for a value of type T: arrays stay arrays
+
+template<typename T>
+using stored_type = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+
+/*
+ * storage modes for large expected values, e.g.
+ *
+ *   assertThat(id, in(borrow(knownIds)));   // knownIds must outlive the matcher
+ *   auto golden = containsInAnyOrder(own(loadRecords("golden.csv")));
+ *
+ * A matcher stores its expected value by value (moved in when it's an
+ * rvalue), so copying or composing it copies the value too. A borrowed
+ * value is referred to instead, and an owned one is kept in a buffer
+ * shared by all copies of the matcher, so neither is ever deep-copied.
+ * Policies see the value itself either way.
+ */
+template<typename T>
+class Borrowed {
 public:
-    Matcher(ExpectedType const& value = ExpectedType()) : expected_(value)
+    constexpr explicit Borrowed(T const& value) : value_(&value)
     { }
 
-    template<class ActualType>
-    bool matches(ActualType const& actual) const {
-        return MatcherPolicy::matches(expected_, actual);
-    }
-
-    template<size_t M>
-    bool matches(char const (&actual)[M]) const {
-        return MatcherPolicy::matches(expected_, std::string(actual));
+    constexpr T const& get() const {
+        return *value_;
     }
 
-    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
-        matcher.describe(o, matcher.expected_);
-        return o;
+    template<typename U = T>
+    auto begin() const -> decltype(std::begin(std::declval<U const&>())) {
+        return std::begin(*value_);
     }
-private:
-    ExpectedType expected_;
-};
 
-// there is no expected value, for matcher not taking input parameters
-template<class MatcherPolicy>
-class Matcher<MatcherPolicy,void> : public MatcherPolicy {
-public:
-    template<class ActualType>
-    bool matches(ActualType const& actual) const {
-        return MatcherPolicy::matches(actual);
+    template<typename U = T>
+    auto end() const -> decltype(std::end(std::declval<U const&>())) {
+        return std::end(*value_);
     }
 
-    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
-        matcher.describe(o);
+    friend std::ostream& operator<<(std::ostream& o, Borrowed const& value) {
+        print_value(o, value.get());
         return o;
     }
+
+private:
+    T const* value_;
 };
 
-// C-style arrays and strings
-template<class MatcherPolicy, class ExpectedType, size_t N>
-class Matcher<MatcherPolicy,ExpectedType[N]> : public MatcherPolicy
-{
+template<typename T>
+class Owned {
 public:
-    Matcher(ExpectedType const (&value)[N]) : expected_(value)
+    explicit Owned(std::shared_ptr<T const> value) : value_(std::move(value))
     { }
 
-    template<size_t M>
-    bool matches(ExpectedType const (&actual)[M]) const {
-        std::vector<ExpectedType> actual_vec(actual, actual + M), expected_vec(expected_, expected_ + N);
-        return MatcherPolicy::matches(expected_vec, actual_vec);
+    T const& get() const {
+        return *value_;
     }
- 
-    bool matches(std::string const& actual) const {
-        return MatcherPolicy::matches(std::string(expected_), actual);
+
+    template<typename U = T>
+    auto begin() const -> decltype(std::begin(std::declval<U const&>())) {
+        return std::begin(*value_);
     }
 
-    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
-        matcher.describe(o, matcher.expected_);
+    template<typename U = T>
+    auto end() const -> decltype(std::end(std::declval<U const&>())) {
+        return std::end(*value_);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Owned const& value) {
+        print_value(o, value.get());
         return o;
     }
+
 private:
-    ExpectedType const (&expected_)[N];
+    std::shared_ptr<T const> value_;
 };
 
-// this is just sugar to make it easy to create a matcher
-// still preferred to use a free function though
+template<typename T>
+constexpr Borrowed<T> borrow(T const& value) {
+    return Borrowed<T>(value);
+}
 
-template<class MatcherPolicy>
-struct MatcherGenerator {
+// a temporary would be gone before the matcher is used
+template<typename T>
+void borrow(T const&&) = delete;
 
-    template<typename... T>
-    Matcher<MatcherPolicy,T...> operator()(T const& ...value) const {
-        return Matcher<MatcherPolicy,T...>(value...); 
+template<typename T>
+Owned<stored_type<T>> own(T&& value) {
+    return Owned<stored_type<T>>(std::make_shared<stored_type<T> const>(std::forward<T>(value)));
+}
+
+// the value a matcher stores, as its policy sees it
+
+template<typename T>
+constexpr T const& stored_value(T const& value) {
+    return value;
+}
+
+template<typename T>
+constexpr T const& stored_value(Borrowed<T> const& value) {
+    return value.get();
+}
+
+template<typename T>
+T const& stored_value(Owned<T> const& value) {
+    return value.get();
+}
+
+/*
+ * the description of a matcher, rendered on first use and kept for later
+ * failures, so a matcher failing over and over in a loop (say, a deep
+ * anyOf tree) is described once. Threads racing to fill it each render,
+ * and the first to publish wins. Copies start out empty.
+ */
+class DescriptionCache {
+public:
+    DescriptionCache() : text_(nullptr)
+    { }
+
+    DescriptionCache(DescriptionCache const&) : text_(nullptr)
+    { }
+
+    DescriptionCache& operator=(DescriptionCache const&) {
+        delete text_.exchange(nullptr, std::memory_order_acq_rel);
+        return *this;
     }
 
-    template<typename T, size_t N>
-    Matcher<MatcherPolicy,T[N]> operator()(T const (&value)[N]) const {
-        return Matcher<MatcherPolicy,T[N]>(value);
+    ~DescriptionCache() {
+        delete text_.load(std::memory_order_acquire);
+    }
+
+    // whether o prints things the way the stream the text is rendered to does
+    static bool applies(std::ostream& o) {
+        return o.flags() == (std::ios_base::skipws | std::ios_base::dec)
+            && o.precision() == 6 && o.width() == 0 && o.getloc() == std::locale();
+    }
+
+    template<class Describe>
+    std::string const& get(Describe describe) const {
+        std::string* text = text_.load(std::memory_order_acquire);
+        if (text)
+            return *text;
+
+        FormatBuffer buffer;
+        FormatStream o(buffer);
+        describe(o);
+        std::unique_ptr<std::string> rendered(new std::string(buffer.str()));
+        if (text_.compare_exchange_strong(text, rendered.get(), std::memory_order_acq_rel,
+                                          std::memory_order_acquire))
+            text = rendered.release();
+        return *text;
+    }
+
+private:
+    mutable std::atomic<std::string*> text_;
+};
+
+// matchers holding only trivially destructible values (numbers, matchers of
+// numbers) stay literal types, for static_assert, and are cheap to describe;
+// matchers holding borrowed values can't trust an earlier rendering
+struct NoDescriptionCache {
+    static constexpr bool applies(std::ostream&) {
+        return false;
+    }
+
+    template<class Describe>
+    std::string get(Describe) const {
+        return std::string();
+    }
+};
+
+// type trait to detect whether T refers to a borrowed value anywhere within
+// it (e.g. allOf(in(borrow(ids)), ...)). The borrowed value may change
+// between failures, so such matchers are described afresh every time.
+
+template<typename T>
+struct holds_borrowed : std::false_type
+{ };
+
+template<typename... Ts>
+struct any_holds_borrowed : std::false_type
+{ };
+
+template<typename T, typename... Ts>
+struct any_holds_borrowed<T, Ts...>
+    : std::integral_constant<
+        bool,
+        holds_borrowed<T>::value || any_holds_borrowed<Ts...>::value
+      >
+{ };
+
+template<typename T>
+struct holds_borrowed<Borrowed<T>> : std::true_type
+{ };
+
+template<typename T, size_t N>
+struct holds_borrowed<T[N]> : holds_borrowed<T>
+{ };
+
+template<typename T, size_t N>
+struct holds_borrowed<std::array<T, N>> : holds_borrowed<T>
+{ };
+
+// tuples, pairs, matchers and the wrappers of their expected values
+template<template<typename...> class Template, typename... Ts>
+struct holds_borrowed<Template<Ts...>> : any_holds_borrowed<Ts...>
+{ };
+
+template<typename T>
+using description_cache = typename std::conditional<
+    std::is_trivially_destructible<T>::value || holds_borrowed<T>::value,
+    NoDescriptionCache,
+    DescriptionCache
+    >::type;
+
+template<class MatcherPolicy, class ExpectedType = void>
+class Matcher : public MatcherPolicy, private description_cache<ExpectedType> {
+public:
+    constexpr Matcher(ExpectedType const& value = ExpectedType()) : expected_(value)
+    { }
+
+    constexpr Matcher(ExpectedType&& value) : expected_(static_cast<ExpectedType&&>(value))
+    { }
+
+    template<class ActualType>
+    constexpr bool matches(ActualType const& actual) const {
+        return MatcherPolicy::matches(stored_value(expected_), actual);
+    }
+
+    template<size_t M>
+    bool matches(char const (&actual)[M]) const {
+        return matches_text(string_ref(actual), 0);
+    }
+
+    // the value the matcher was built with
+    constexpr auto expected() const -> decltype(stored_value(std::declval<ExpectedType const&>())) {
+        return stored_value(expected_);
+    }
+
+    // prints the actual value, unless the policy can explain the mismatch
+    template<class ActualType>
+    void describeMismatch(std::ostream& o, ActualType const& actual) const {
+        describe_mismatch(o, actual, 0);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
+        if (matcher.description().applies(o))
+            o << matcher.description().get([&matcher](std::ostream& out) {
+                matcher.describe(out, stored_value(matcher.expected_));
+            });
+        else
+            matcher.describe(o, stored_value(matcher.expected_));
+        return o;
+    }
+private:
+    template<class ActualType, class Policy = MatcherPolicy>
+    auto describe_mismatch(std::ostream& o, ActualType const& actual, int) const
+        -> decltype(std::declval<Matcher<Policy,ExpectedType> const&>().Policy::describeMismatch(o, stored_value(std::declval<ExpectedType const&>()), actual))
+    {
+        Policy::describeMismatch(o, stored_value(expected_), actual);
+    }
+
+    template<class ActualType>
+    void describe_mismatch(std::ostream& o, ActualType const& actual, long) const {
+        print_value(o, actual);
+    }
+
+    // string literals are handed over as a string_ref, without copying,
+    // unless the policy only takes a std::string
+    template<class Policy = MatcherPolicy>
+    auto matches_text(string_ref actual, int) const
+        -> decltype(std::declval<Matcher<Policy,ExpectedType> const&>().Policy::matches(stored_value(std::declval<ExpectedType const&>()), actual))
+    {
+        return Policy::matches(stored_value(expected_), actual);
+    }
+
+    bool matches_text(string_ref actual, long) const {
+        return MatcherPolicy::matches(stored_value(expected_), actual.str());
+    }
+
+    description_cache<ExpectedType> const& description() const {
+        return *this;
+    }
+
+    ExpectedType expected_;
+};
+
+// there is no expected value, for matcher not taking input parameters
+template<class MatcherPolicy>
+class Matcher<MatcherPolicy,void> : public MatcherPolicy {
+public:
+    template<class ActualType>
+    constexpr bool matches(ActualType const& actual) const {
+        return MatcherPolicy::matches(actual);
+    }
+
+    template<class ActualType>
+    void describeMismatch(std::ostream& o, ActualType const& actual) const {
+        describe_mismatch(o, actual, 0);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
+        matcher.describe(o);
+        return o;
+    }
+private:
+    template<class ActualType, class Policy = MatcherPolicy>
+    auto describe_mismatch(std::ostream& o, ActualType const& actual, int) const
+        -> decltype(std::declval<Matcher<Policy> const&>().Policy::describeMismatch(o, actual))
+    {
+        Policy::describeMismatch(o, actual);
+    }
+
+    template<class ActualType>
+    void describe_mismatch(std::ostream& o, ActualType const& actual, long) const {
+        print_value(o, actual);
+    }
+};
+
+// C-style arrays and strings
+template<class MatcherPolicy, class ExpectedType, size_t N>
+class Matcher<MatcherPolicy,ExpectedType[N]> : public MatcherPolicy
+{
+public:
+    Matcher(ExpectedType const (&value)[N]) {
+        std::copy(value, value + N, expected_);
+    }
+
+    template<size_t M>
+    bool matches(ExpectedType const (&actual)[M]) const {
+        return MatcherPolicy::matches(make_view(expected_), make_view(actual));
+    }
+
+    bool matches(string_ref actual) const {
+        return MatcherPolicy::matches(make_view(expected_), actual);
+    }
+
+    template<class ActualType>
+    void describeMismatch(std::ostream& o, ActualType const& actual) const {
+        print_value(o, actual);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Matcher const& matcher) {
+        matcher.describe(o, matcher.expected_);
+        return o;
+    }
+private:
+    ExpectedType expected_[N];
+};
+
+// this is just sugar to make it easy to create a matcher
+// still preferred to use a free function though
+
+template<class MatcherPolicy>
+struct MatcherGenerator {
+
+    template<typename... T>
+    constexpr Matcher<MatcherPolicy,stored_type<T>...> operator()(T&& ...value) const {
+        return Matcher<MatcherPolicy,stored_type<T>...>(static_cast<T&&>(value)...);
     }
 };
 
 template<class MatcherPolicy>
-MatcherGenerator<MatcherPolicy> make_matcher() {
+constexpr MatcherGenerator<MatcherPolicy> make_matcher() {
     return MatcherGenerator<MatcherPolicy>();
 }
 
@@ -376,7 +1182,7 @@ struct is_matcher<First, Rest...>
 struct Is {
 protected:
     template<typename MatcherType, typename ActualType>
-    bool matches(MatcherType const& expected, ActualType const& actual) const {
+    constexpr bool matches(MatcherType const& expected, ActualType const& actual) const {
         static_assert(is_matcher<MatcherType>::value, "IsNot matcher requires a Matcher parameter");
         return expected.matches(actual);
     }
@@ -387,12 +1193,12 @@ protected:
     }
 };
 
-auto is = make_matcher<Is>();
+constexpr auto is = make_matcher<Is>();
 
 struct IsNot_ {
 protected:
     template<typename MatcherType, typename ActualType>
-    bool matches(MatcherType const& expected, ActualType const& actual) const {
+    constexpr bool matches(MatcherType const& expected, ActualType const& actual) const {
         return !expected.matches(actual);
     }
 
@@ -406,16 +1212,18 @@ template<class T>
 using IsNot = Matcher<IsNot_,T>;
 
 
-template<class T>
+// constrained to matchers, so that it never gets picked for other types
+// (e.g. enumerations used within <regex>)
+template<class T,
+     typename std::enable_if<is_matcher<T>::value>::type* = nullptr>
 constexpr IsNot<T> operator!(T const& value) {
-    static_assert(is_matcher<T>::value, "IsNot matcher requires a Matcher parameter");
     return IsNot<T>(value);
 }
 
 struct IsNull {
 protected:
     template<typename T>
-    bool matches(T const* actual) const {
+    constexpr bool matches(T const* actual) const {
         return actual == nullptr;
     }
 
@@ -424,13 +1232,13 @@ protected:
     }
 };
 
-auto null = make_matcher<IsNull>();
+constexpr auto null = make_matcher<IsNull>();
 
 
 struct IsEqual {
 protected:
     template<typename T>
-    bool matches(T const& expected, T const& actual,
+    constexpr bool matches(T const& expected, T const& actual,
                  typename std::enable_if<
                     is_equality_comparable<T>::value
                     >::type* = 0) const
@@ -448,166 +1256,1141 @@ protected:
         return !std::memcmp(&expected, &actual, sizeof expected);
     }
 
-    template<typename T>
-    void describe(std::ostream& o, T const& expected) const {
-       o << expected;
+    bool matches(string_ref expected, string_ref actual) const {
+        return expected == actual;
+    }
+
+    template<char... Cs>
+    bool matches(literal<Cs...> const&, string_ref actual) const {
+        return actual.size() == sizeof...(Cs)
+            && !std::memcmp(actual.data(), literal<Cs...>::value, sizeof...(Cs));
+    }
+
+    template<char... Cs>
+    void describe(std::ostream& o, literal<Cs...> const& expected) const {
+       o << "\"" << expected << "\"";
+    }
+
+    template<typename T>
+    void describe(std::ostream& o, T const& expected) const {
+       print_value(o, expected);
+    }
+};
+
+template<>
+void IsEqual::describe(std::ostream& o, std::string const& expected) const {
+   o << "\"" << expected << "\"";
+}
+
+constexpr auto equalTo = make_matcher<IsEqual>();
+
+// collect mode: report how many items failed, and a sample of them
+struct Collect {
+    size_t samples;
+};
+
+inline Collect collect(size_t samples = 5) {
+    return Collect{ samples };
+}
+
+template<typename M>
+struct Collecting {
+    M matcher;
+    size_t samples;
+};
+
+// the number of items an everyItem in collect mode went through, and a sample of the failed ones
+template<typename T>
+struct CollectedFailures {
+    explicit CollectedFailures(size_t samples = 0) : items(0), failures(samples)
+    { }
+
+    size_t items;
+    Reservoir<std::pair<size_t,T>> failures;
+};
+
+// the items a container must hold in order, for containsInOrder
+template<typename C>
+struct InOrder {
+    C items;
+};
+
+// SFINAE type trait to detect whether std::hash supports type T
+
+template<typename T, typename = void>
+struct is_hashable : std::false_type
+{ };
+
+template<typename T>
+struct is_hashable<T,
+    typename std::enable_if<
+        true,
+        decltype(std::hash<T>()(std::declval<T const&>()), (void)0)
+        >::type
+    > : std::true_type
+{ };
+
+// multiset of items counted in a hash table, or in a tree if they can't be hashed
+template<typename T, bool = is_hashable<T>::value>
+struct item_counts {
+    typedef std::unordered_map<T,size_t> type;
+};
+
+template<typename T>
+struct item_counts<T,false> {
+    typedef std::map<T,size_t> type;
+};
+
+// the items a container must hold, in any order, for containsInAnyOrder
+template<typename C>
+struct InAnyOrder {
+    C items;
+};
+
+/*
+ * how many times each of the expected items of containsInAnyOrder is
+ * still to be seen. The table refers to the items instead of copying
+ * them, and is filled afresh for each match, so it always reflects a
+ * borrowed collection as it is. It lives in a buffer of the calling
+ * thread reused from one match to the next: an open-addressing table
+ * over std::hash, or a tree for items that can't be hashed.
+ */
+template<typename T, bool = is_hashable<T>::value>
+class ItemTally {
+public:
+    // the tally of this thread, filled with the given items
+    template<typename C>
+    static ItemTally& of(C const& items) {
+        static thread_local ItemTally tally;
+        tally.fill(items);
+        return tally;
+    }
+
+    size_t total() const { return total_; }
+
+    // the count left for an item, or null if it isn't expected at all
+    size_t* find(T const& item) {
+        Slot& slot = probe(item);
+        return slot.item ? &slot.count : nullptr;
+    }
+
+private:
+    struct Slot {
+        T const* item;
+        size_t count;
+    };
+
+    template<typename C>
+    void fill(C const& items) {
+        static_assert(std::is_reference<decltype(*std::begin(items))>::value,
+                      "containsInAnyOrder needs a collection holding its items");
+        size_t capacity = 16;
+        while (capacity < 2 * range_size(items))
+            capacity <<= 1;
+        slots_.assign(capacity, Slot{ nullptr, 0 });
+        total_ = 0;
+        for (auto it = std::begin(items); it != std::end(items); ++it, ++total_) {
+            Slot& slot = probe(*it);
+            slot.item = &*it;
+            ++slot.count;
+        }
+    }
+
+    Slot& probe(T const& item) {
+        size_t mask = slots_.size() - 1;
+        for (size_t i = std::hash<T>()(item) & mask; ; i = (i + 1) & mask) {
+            if (!slots_[i].item || *slots_[i].item == item)
+                return slots_[i];
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t total_;
+};
+
+template<typename T>
+class ItemTally<T,false> {
+public:
+    template<typename C>
+    static ItemTally& of(C const& items) {
+        static thread_local ItemTally tally;
+        tally.fill(items);
+        return tally;
+    }
+
+    size_t total() const { return total_; }
+
+    size_t* find(T const& item) {
+        auto found = counts_.find(&item);
+        return found != counts_.end() ? &found->second : nullptr;
+    }
+
+private:
+    struct Less {
+        bool operator()(T const* a, T const* b) const {
+            return *a < *b;
+        }
+    };
+
+    template<typename C>
+    void fill(C const& items) {
+        static_assert(std::is_reference<decltype(*std::begin(items))>::value,
+                      "containsInAnyOrder needs a collection holding its items");
+        counts_.clear();
+        total_ = 0;
+        for (auto it = std::begin(items); it != std::end(items); ++it, ++total_)
+            ++counts_[&*it];
+    }
+
+    std::map<T const*, size_t, Less> counts_;
+    size_t total_;
+};
+
+/*
+ * a range known to be sorted (by operator<), which contains, in and
+ * isUnique search by bisection or adjacent items instead of scanning, e.g.
+ *
+ *   assertThat(id, in(sorted(ids)));
+ *   assertThat(sorted(borrow(timestamps)), contains(t));
+ */
+template<typename C>
+struct Sorted {
+    C items;
+
+    auto begin() const -> decltype(std::begin(std::declval<C const&>())) {
+        return std::begin(items);
+    }
+
+    auto end() const -> decltype(std::end(std::declval<C const&>())) {
+        return std::end(items);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Sorted const& range) {
+        print_value(o, range.items);
+        return o;
+    }
+};
+
+template<typename C>
+Sorted<stored_type<C>> sorted(C&& items) {
+    return Sorted<stored_type<C>>{ std::forward<C>(items) };
+}
+
+// whether cont holds item: looked up by the container itself if it can
+// (sets and hash sets), by binary search if sorted, or else by a scan
+
+template<typename C, typename T>
+auto contains_item(C const& cont, T const& item, int) -> decltype(cont.find(item) == cont.end()) {
+    return cont.find(item) != cont.end();
+}
+
+// a set of strings can only be searched for a std::string (C++11 has no
+// heterogeneous lookup), so the text is copied, which allocates only past
+// the small-string buffer
+template<typename C>
+typename std::enable_if<std::is_same<typename C::key_type, std::string>::value, bool>::type
+contains_item(C const& cont, string_ref item, int) {
+    return cont.find(std::string(item.data(), item.size())) != cont.end();
+}
+
+template<typename C, typename T>
+bool contains_item(Sorted<C> const& cont, T const& item, int) {
+    return std::binary_search(std::begin(cont), std::end(cont), item);
+}
+
+template<typename C, typename T>
+bool contains_item(C const& cont, T const& item, long) {
+    return std::end(cont) != std::find(std::begin(cont), std::end(cont), item);
+}
+
+// how many items of a container must match, for atLeast, atMost and exactly
+template<typename M>
+struct Quantified {
+    static constexpr size_t unbounded = size_t(-1);
+
+    size_t min;
+    size_t max;
+    M matcher;
+};
+
+struct IsContaining_ {
+protected:
+    template<typename C, typename T,
+         typename std::enable_if<std::is_same<typename range_value<C>::type,T>::value>::type* = nullptr>
+    bool matches(T const& item, C const& cont) const {
+        return contains_item(cont, item, 0);
+    }
+
+    template<typename T, size_t N>
+    bool matches(T const& item, T const (&array)[N]) const {
+        return std::end(array) != std::find(std::begin(array), std::end(array), item);
+    }
+
+    template<typename C = std::string, typename T = std::string>
+    bool matches(std::string const& substr, std::string const& actual) const {
+        return std::string::npos != actual.find(substr);
+    }
+
+    bool matches(string_ref substr, string_ref actual) const {
+        return std::string::npos != actual.find(substr);
+    }
+
+    // overload for checking whether container values match a predicate specified by a Matcher
+    template<typename C, typename T, typename Policy>
+    bool matches(Matcher<Policy,T> const& itemMatcher, C const& cont) const {
+        typedef typename range_value<C>::type value_type;
+        return std::all_of(std::begin(cont), std::end(cont),
+                           [&itemMatcher](value_type const& item) {
+                               return itemMatcher.matches(item);
+                           });
+    }
+
+    // goes through every item, counting the failures and keeping a
+    // fixed-size sample of them along with their positions for the report
+    template<typename C, typename M>
+    bool matches(Collecting<M> const& c, C const& cont) const {
+        typedef CollectedFailures<typename range_value<C>::type> Report;
+        Report report = collect_failures(c, cont);
+        bool passed = report.failures.seen() == 0;
+        LastMatch<Report>::record(&c, &cont, std::move(report));
+        return passed;
+    }
+
+    // counts matching items, and stops as soon as the outcome is known
+    template<typename C, typename M>
+    bool matches(Quantified<M> const& q, C const& cont) const {
+        size_t size = size_t(q.unbounded);
+        if (has_size<C>::value) {
+            size = range_size(cont);
+            if (size < q.min)
+                return false;
+            if (q.min == 0 && size <= q.max)
+                return true;
+        }
+
+        size_t count = 0, seen = 0;
+        for (auto it = std::begin(cont); it != std::end(cont); ++it) {
+            ++seen;
+            if (q.matcher.matches(*it)) {
+                if (++count > q.max)
+                    return false;
+                if (count >= q.min && q.max == q.unbounded)
+                    return true;
+            }
+            else if (size != q.unbounded && count + (size - seen) < q.min)
+                return false;
+        }
+        return count >= q.min;
+    }
+
+    // one counting pass: each actual item takes one off the count of its
+    // expected item, failing if there's none left. Neither the expected nor
+    // the actual items are copied
+    template<typename C, typename E>
+    bool matches(InAnyOrder<E> const& expected, C const& cont) const {
+        auto& left = tally_of(expected);
+        if (has_size<C>::value && range_size(cont) != left.total())
+            return false;
+
+        size_t n = 0;
+        for (auto it = std::begin(cont); it != std::end(cont); ++it, ++n) {
+            size_t* count = left.find(*it);
+            if (!count || *count == 0)
+                return false;
+            --*count;
+        }
+        return n == left.total();
+    }
+
+    // the expected items appear in the container in the same order,
+    // though not necessarily next to each other
+    template<typename C, typename E>
+    bool matches(InOrder<E> const& expected, C const& cont) const {
+        return in_order(expected.items, cont).first == std::end(expected.items);
+    }
+
+    template<typename T>
+    void describe(std::ostream& o, T const& expected) const {
+       o << "contains " << expected;
+    }
+
+    template<typename E>
+    void describe(std::ostream& o, InAnyOrder<E> const& expected) const {
+       o << "contains in any order ";
+       print_items(o, expected.items);
+    }
+
+    template<typename E>
+    void describe(std::ostream& o, InOrder<E> const& expected) const {
+       o << "contains in order ";
+       print_items(o, expected.items);
+    }
+
+    // missing items are listed in the order they were given
+    template<typename C, typename E>
+    void describeMismatch(std::ostream& o, InAnyOrder<E> const& expected, C const& cont) const {
+        auto& left = tally_of(expected);
+
+        size_t unexpected = 0, n = 0;
+        for (auto it = std::begin(cont); it != std::end(cont); ++it, ++n) {
+            size_t* count = left.find(*it);
+            if (count && *count) {
+                --*count;
+                continue;
+            }
+            if (unexpected++ < maxReported)
+                o << (unexpected > 1 ? ", " : "unexpected ") << "#" << n << ": " << *it;
+        }
+        if (unexpected > maxReported)
+            o << ", ... (" << unexpected << " in all)";
+
+        size_t missing = 0;
+        auto const& items = stored_value(expected.items);
+        for (auto it = std::begin(items); it != std::end(items); ++it) {
+            size_t* count = left.find(*it);
+            if (!*count)
+                continue;
+            --*count;
+            if (missing++ < maxReported)
+                o << (missing > 1 ? ", " : (unexpected ? "; missing " : "missing ")) << *it;
+        }
+        if (missing > maxReported)
+            o << ", ... (" << missing << " in all)";
+    }
+
+    // a single-pass range can't be read again
+    template<typename E, typename InputIt>
+    void describeMismatch(std::ostream& o, InAnyOrder<E> const&, InputRange<InputIt> const& actual) const {
+        o << actual;
+    }
+
+    template<typename C, typename E>
+    void describeMismatch(std::ostream& o, InOrder<E> const& expected, C const& cont) const {
+        auto result = in_order(expected.items, cont);
+        size_t found = std::distance(std::begin(expected.items), result.first);
+
+        o << found << " items in order";
+        if (found)
+            o << ", the last at #" << result.second;
+        size_t missing = 0;
+        for (auto it = result.first; it != std::end(expected.items); ++it) {
+            if (missing++ < maxReported)
+                o << (missing > 1 ? ", " : "; missing ") << *it;
+        }
+        if (missing > maxReported)
+            o << ", ...";
+    }
+
+    template<typename E, typename InputIt>
+    void describeMismatch(std::ostream& o, InOrder<E> const&, InputRange<InputIt> const& actual) const {
+        o << actual;
+    }
+
+    template<typename M>
+    void describe(std::ostream& o, Collecting<M> const& expected) const {
+       o << "every item " << expected.matcher;
+    }
+
+    // reports what matches() collected, going through the items again
+    // only if the container wasn't matched last on this thread
+    template<typename M, typename C>
+    void describeMismatch(std::ostream& o, Collecting<M> const& expected, C const& cont) const {
+        typedef typename range_value<C>::type value_type;
+        typedef CollectedFailures<value_type> Report;
+        Report const* recorded = LastMatch<Report>::find(&expected, &cont);
+        Report report = recorded ? *recorded : collect_failures(expected, cont);
+        auto const& failures = report.failures;
+        size_t n = report.items;
+
+        o << failures.seen() << " of " << n << " items failed";
+        if (!failures.seen())
+            return;
+        o << " (" << 100.0 * failures.seen() / n << "%)";
+
+        auto sample = failures.items();
+        std::sort(sample.begin(), sample.end(),
+                  [](std::pair<size_t,value_type> const& a, std::pair<size_t,value_type> const& b) {
+                      return a.first < b.first;
+                  });
+        for (size_t i = 0; i < sample.size(); ++i)
+            o << (i ? ", " : ", e.g. ") << "#" << sample[i].first << ": " << sample[i].second;
+    }
+
+    template<typename M>
+    void describe(std::ostream& o, Quantified<M> const& expected) const {
+        if (expected.min == expected.max)
+            o << "exactly " << expected.min;
+        else if (expected.max == expected.unbounded)
+            o << "at least " << expected.min;
+        else
+            o << "at most " << expected.max;
+        o << " items " << expected.matcher;
+    }
+
+    template<typename T, typename Policy>
+    void describe(std::ostream& o, Matcher<Policy,T> const& expected) const {
+       o << "every item " << expected;
+    }
+
+private:
+    static constexpr size_t maxReported = 10;
+
+    template<typename M, typename C>
+    static CollectedFailures<typename range_value<C>::type>
+    collect_failures(Collecting<M> const& c, C const& cont) {
+        typedef typename range_value<C>::type value_type;
+        CollectedFailures<value_type> report(c.samples);
+        for (auto it = std::begin(cont); it != std::end(cont); ++it, ++report.items) {
+            if (!c.matcher.matches(*it))
+                report.failures.add(std::make_pair(report.items, value_type(*it)));
+        }
+        return report;
+    }
+
+    // the expected items, counted afresh in the table of the calling thread
+    template<typename E>
+    static ItemTally<typename range_value<E>::type>& tally_of(InAnyOrder<E> const& expected) {
+        return ItemTally<typename range_value<E>::type>::of(stored_value(expected.items));
+    }
+
+    // the first maxReported items, and how many there are in all if more
+    template<typename E>
+    static void print_items(std::ostream& o, E const& items) {
+        size_t n = 0;
+        o << "[";
+        for (auto it = std::begin(items); it != std::end(items); ++it, ++n) {
+            if (n < maxReported) {
+                o << (n ? ", " : "");
+                print_value(o, *it);
+            }
+        }
+        if (n > maxReported)
+            o << ", ... (" << n << " in all)";
+        o << "]";
+    }
+
+    // the first expected item not found in order, and the position of the
+    // container item matching the one before it
+    template<typename E, typename C>
+    static std::pair<decltype(std::begin(std::declval<E const&>())),size_t>
+    in_order(E const& items, C const& cont) {
+        auto next = std::begin(items);
+        size_t n = 0, last = 0;
+        for (auto it = std::begin(cont); it != std::end(cont) && next != std::end(items); ++it, ++n) {
+            if (*it == *next) {
+                ++next;
+                last = n;
+            }
+        }
+        return std::make_pair(next, last);
+    }
+};
+
+template<>
+void IsContaining_::describe(std::ostream& o, std::string const& expected) const {
+   o << "contains " << "\"" << expected << "\"";
+}
+
+template<class T>
+using IsContaining = Matcher<IsContaining_,T>;
+
+template<typename T>
+constexpr IsContaining<T> contains(T const& value) {
+    return IsContaining<T>(value);
+}
+
+template<typename T, size_t N>
+constexpr IsContaining<T[N]> contains(T const (&value)[N]) {
+    return IsContaining<T[N]>(value);
+}
+
+template<class Key, class T>
+constexpr IsContaining<std::pair<const Key,T>> contains(Key const& key, T const& value) {
+    return IsContaining<std::pair<const Key,T>>(std::pair<const Key,T>(key, value));
+}
+
+template<typename T, typename Policy>
+constexpr IsContaining<Matcher<Policy,T>> everyItem(Matcher<Policy,T> const& itemMatcher) {
+    return IsContaining<Matcher<Policy,T>>(itemMatcher);
+}
+
+template<typename T, typename Policy>
+constexpr IsContaining<Collecting<Matcher<Policy,T>>> everyItem(Matcher<Policy,T> const& itemMatcher, Collect mode) {
+    return IsContaining<Collecting<Matcher<Policy,T>>>({ itemMatcher, mode.samples });
+}
+
+template<typename T, typename Policy>
+IsContaining<Quantified<Matcher<Policy,T>>> atLeast(size_t k, Matcher<Policy,T> const& itemMatcher) {
+    return IsContaining<Quantified<Matcher<Policy,T>>>({ k, Quantified<Matcher<Policy,T>>::unbounded, itemMatcher });
+}
+
+template<typename T, typename Policy>
+IsContaining<Quantified<Matcher<Policy,T>>> atMost(size_t k, Matcher<Policy,T> const& itemMatcher) {
+    return IsContaining<Quantified<Matcher<Policy,T>>>({ 0, k, itemMatcher });
+}
+
+template<typename T, typename Policy>
+IsContaining<Quantified<Matcher<Policy,T>>> exactly(size_t k, Matcher<Policy,T> const& itemMatcher) {
+    return IsContaining<Quantified<Matcher<Policy,T>>>({ k, k, itemMatcher });
+}
+
+template<typename C>
+IsContaining<InAnyOrder<stored_type<C>>> containsInAnyOrder(C&& items) {
+    return IsContaining<InAnyOrder<stored_type<C>>>({ std::forward<C>(items) });
+}
+
+template<typename T>
+IsContaining<InAnyOrder<std::vector<T>>> containsInAnyOrder(std::initializer_list<T> items) {
+    return IsContaining<InAnyOrder<std::vector<T>>>({ std::vector<T>(items) });
+}
+
+template<typename C>
+IsContaining<InOrder<stored_type<C>>> containsInOrder(C&& items) {
+    return IsContaining<InOrder<stored_type<C>>>({ std::forward<C>(items) });
+}
+
+template<typename T>
+IsContaining<InOrder<std::vector<T>>> containsInOrder(std::initializer_list<T> items) {
+    return IsContaining<InOrder<std::vector<T>>>({ std::vector<T>(items) });
+}
+
+struct HasSize_ {
+protected:
+    template<typename C, typename T, typename Policy>
+    bool matches(Matcher<Policy,T> const& sizeMatcher, C const& cont) const {
+        typedef typename std::conditional<std::is_arithmetic<T>::value, T, size_t>::type size_type;
+        return sizeMatcher.matches(static_cast<size_type>(range_size(cont)));
+    }
+
+    template<typename T, typename Policy>
+    void describe(std::ostream& o, Matcher<Policy,T> const& expected) const {
+       o << "a collection with size " << expected;
+    }
+};
+
+template<typename T>
+using HasSize = Matcher<HasSize_,T>;
+
+template<typename T, typename Policy>
+constexpr HasSize<Matcher<Policy,T>> hasSize(Matcher<Policy,T> const& sizeMatcher) {
+    return HasSize<Matcher<Policy,T>>(sizeMatcher);
+}
+
+template<typename T,
+     typename std::enable_if<std::is_integral<T>::value>::type* = nullptr>
+HasSize<Matcher<IsEqual,T>> hasSize(T size) {
+    return HasSize<Matcher<IsEqual,T>>(equalTo(size));
+}
+
+struct IsContainingKey {
+protected:
+    template<typename C, typename T,
+         typename std::enable_if<std::is_same<typename C::key_type,T>::value>::type* = nullptr>
+    bool matches(T const& key, C const& cont) const {
+        for (auto const& val : cont) {
+            if (val.first == key)
+                return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    void describe(std::ostream& o, T const& expected) const {
+       o << "has key " << expected;
+    }
+};
+
+constexpr auto hasKey = make_matcher<IsContainingKey>();
+
+struct IsIn_ {
+protected:
+    template<typename C, typename T,
+         typename std::enable_if<std::is_same<typename range_value<C>::type,T>::value>::type* = nullptr>
+    bool matches(C const& cont, T const& item) const {
+        return contains_item(cont, item, 0);
+    }
+
+    // a string literal, looked up in strings without copying it
+    template<typename C,
+         typename std::enable_if<std::is_same<typename range_value<C>::type,std::string>::value>::type* = nullptr>
+    bool matches(C const& cont, string_ref item) const {
+        return contains_item(cont, item, 0);
+    }
+
+    template<typename T, size_t N>
+    bool matches(T const (&array)[N], T const& item) const {
+        return std::end(array) != std::find(std::begin(array), std::end(array), item);
+    }
+
+    template<typename C>
+    void describe(std::ostream& o, C const& expected) const {
+       o << "one of " << expected;
+    }
+
+};
+
+template<typename C>
+using IsIn = Matcher<IsIn_,C>;
+
+template<typename C>
+constexpr IsIn<stored_type<C>> in(C&& cont) {
+    return IsIn<stored_type<C>>(static_cast<C&&>(cont));
+}
+
+template<typename T, typename... Args>
+IsIn<std::vector<T>> oneOf(T const& first, Args const& ... args) {
+    std::vector<T> cont{first, args...};
+    return IsIn<std::vector<T>>(std::move(cont));
+}
+
+template<size_t M, size_t... N>
+IsIn<std::vector<std::string>> oneOf(const char (&first)[M], const char (&...args)[N]) {
+    std::vector<std::string> cont{first, args...};
+    return IsIn<std::vector<std::string>>(std::move(cont));
+}
+
+struct IsEmpty_ {
+protected:
+    template<typename C>
+    bool matches(C const& actual) const {
+        static_assert(is_range<C>::value, "empty matcher is for containers and ranges");
+        return std::begin(actual) == std::end(actual);
+    }
+
+    void describe(std::ostream& o) const {
+        o << "an empty container";
+    }
+};
+
+using IsEmpty = Matcher<IsEmpty_>;
+
+constexpr IsEmpty empty() {
+    return IsEmpty();
+}
+
+// SFINAE type trait to detect whether C keeps numbers contiguously, with data() and size()
+
+template<typename C, typename = void>
+struct is_contiguous_arithmetic : std::false_type
+{ };
+
+template<typename C>
+struct is_contiguous_arithmetic<C,
+    typename std::enable_if<
+        std::is_pointer<decltype(std::declval<C const&>().data())>::value
+        && std::is_arithmetic<typename std::remove_pointer<decltype(std::declval<C const&>().data())>::type>::value
+        && has_size<C>::value
+        >::type
+    > : std::true_type
+{ };
+
+/*
+ * the position of the first item out of order (less than the one before
+ * it, or not greater if Strict), or 0 if there is none. Blocks of items are compared
+ * without branching, so that the compiler turns the comparisons into
+ * vector instructions; the block holding the culprit is then rescanned.
+ */
+template<bool Strict, typename T>
+size_t first_unsorted(const T* a, size_t n) {
+    static constexpr size_t block = 32;
+    size_t i = 1;
+    for (; i + block <= n; i += block) {
+        unsigned bad = 0;
+        for (size_t k = 0; k < block; ++k)
+            bad += Strict ? !(a[i + k - 1] < a[i + k]) : a[i + k] < a[i + k - 1];
+        if (bad)
+            break;
+    }
+    for (; i < n; ++i)
+        if (Strict ? !(a[i - 1] < a[i]) : a[i] < a[i - 1])
+            return i;
+    return 0;
+}
+
+template<bool Strict, typename C>
+typename std::enable_if<is_contiguous_arithmetic<C>::value, size_t>::type
+first_unsorted(C const& cont) {
+    return first_unsorted<Strict>(cont.data(), cont.size());
+}
+
+// items of a multi-pass range are compared where they are
+template<bool Strict, typename C>
+size_t first_unsorted(C const& cont, std::forward_iterator_tag) {
+    auto it = std::begin(cont);
+    if (it == std::end(cont))
+        return 0;
+    auto prev = it;
+    size_t n = 1;
+    for (++it; it != std::end(cont); prev = it++, ++n) {
+        if (Strict ? !(*prev < *it) : *it < *prev)
+            return n;
+    }
+    return 0;
+}
+
+// a single-pass range can't be read again, so the previous item is copied
+template<bool Strict, typename C>
+size_t first_unsorted(C const& cont, std::input_iterator_tag) {
+    auto it = std::begin(cont);
+    if (it == std::end(cont))
+        return 0;
+    typename range_value<C>::type prev = *it;
+    size_t n = 1;
+    for (++it; it != std::end(cont); ++it, ++n) {
+        if (Strict ? !(prev < *it) : *it < prev)
+            return n;
+        prev = *it;
+    }
+    return 0;
+}
+
+template<bool Strict, typename C>
+typename std::enable_if<!is_contiguous_arithmetic<C>::value, size_t>::type
+first_unsorted(C const& cont) {
+    typedef decltype(std::begin(cont)) Iterator;
+    return first_unsorted<Strict>(cont, typename std::iterator_traits<Iterator>::iterator_category());
+}
+
+template<bool Strict>
+struct IsSorted_ {
+protected:
+    template<typename C>
+    bool matches(C const& actual) const {
+        static_assert(is_range<C>::value, "isSorted matcher is for containers and ranges");
+        return first_unsorted<Strict>(actual) == 0;
+    }
+
+    void describe(std::ostream& o) const {
+        o << (Strict ? "a strictly sorted collection" : "a sorted collection");
+    }
+
+    template<typename C>
+    void describeMismatch(std::ostream& o, C const& actual) const {
+        size_t at = first_unsorted<Strict>(actual);
+        auto it = std::begin(actual);
+        std::advance(it, at - 1);
+        auto prev = it++;
+        o << "#" << at << ": ";
+        print_value(o, *it);
+        o << " after ";
+        print_value(o, *prev);
+    }
+
+    // a single-pass range can't be read again
+    template<typename InputIt>
+    void describeMismatch(std::ostream& o, InputRange<InputIt> const& actual) const {
+        o << actual;
+    }
+};
+
+using IsSorted = Matcher<IsSorted_<false>>;
+using IsStrictlySorted = Matcher<IsSorted_<true>>;
+
+constexpr IsSorted isSorted() {
+    return IsSorted();
+}
+
+constexpr IsStrictlySorted isStrictlySorted() {
+    return IsStrictlySorted();
+}
+
+/*
+ * the position of the first item equal to an earlier one, and of that
+ * one, or the number of items: adjacent items are compared in a sorted
+ * range, the others are looked up in a hash table (a tree if the items
+ * can't be hashed)
+ */
+template<typename C>
+std::pair<size_t,size_t> first_duplicate(Sorted<C> const& cont) {
+    size_t n = 0;
+    for (auto it = std::begin(cont), prev = it; it != std::end(cont); prev = it++, ++n)
+        if (n && *prev == *it)
+            return std::make_pair(n, n - 1);
+    return std::make_pair(n, n);
+}
+
+template<typename C>
+std::pair<size_t,size_t> first_duplicate(C const& cont) {
+    typedef typename range_value<C>::type value_type;
+    typename item_counts<value_type>::type seen;
+    size_t n = 0;
+    for (auto it = std::begin(cont); it != std::end(cont); ++it, ++n) {
+        auto inserted = seen.emplace(*it, n);
+        if (!inserted.second)
+            return std::make_pair(n, inserted.first->second);
+    }
+    return std::make_pair(n, n);
+}
+
+struct IsUnique_ {
+protected:
+    template<typename C>
+    bool matches(C const& actual) const {
+        static_assert(is_range<C>::value, "isUnique matcher is for containers and ranges");
+        auto dup = first_duplicate(actual);
+        return dup.first == dup.second;
+    }
+
+    void describe(std::ostream& o) const {
+        o << "a collection without duplicates";
+    }
+
+    template<typename C>
+    void describeMismatch(std::ostream& o, C const& actual) const {
+        auto dup = first_duplicate(actual);
+        auto it = std::begin(actual);
+        std::advance(it, dup.first);
+        o << "#" << dup.first << ": ";
+        print_value(o, *it);
+        o << ", already at #" << dup.second;
+    }
+
+    template<typename InputIt>
+    void describeMismatch(std::ostream& o, InputRange<InputIt> const& actual) const {
+        o << actual;
     }
 };
 
-template<>
-void IsEqual::describe(std::ostream& o, std::string const& expected) const {
-   o << "\"" << expected << "\"";
+using IsUnique = Matcher<IsUnique_>;
+
+constexpr IsUnique isUnique() {
+    return IsUnique();
 }
 
-auto equalTo = make_matcher<IsEqual>();
+// SFINAE type trait to detect ranges sorted by operator<: sorted(c), and
+// the ordered sets using std::less
 
-struct IsContaining_ {
-protected:
-    template<typename C, typename T,
-         typename std::enable_if<std::is_same<typename C::value_type,T>::value>::type* = nullptr>
-    bool matches(T const& item, C const& cont) const {
-        return std::end(cont) != std::find(std::begin(cont), std::end(cont), item);
-    }
+template<typename C, typename = void>
+struct is_sorted_range : std::false_type
+{ };
 
-    template<typename T, size_t N>
-    bool matches(T const& item, T const (&array)[N]) const {
-        return std::end(array) != std::find(std::begin(array), std::end(array), item);
-    }
+template<typename C>
+struct is_sorted_range<Sorted<C>> : std::true_type
+{ };
 
-    template<typename C = std::string, typename T = std::string>
-    bool matches(std::string const& substr, std::string const& actual) const {
-        return std::string::npos != actual.find(substr);
-    }
+template<typename C>
+struct is_sorted_range<C,
+    typename std::enable_if<
+        std::is_same<typename C::key_compare, std::less<typename C::value_type>>::value
+        >::type
+    > : std::true_type
+{ };
 
-    // overload for checking whether container values match a predicate specified by a Matcher
-    template<typename C, typename T, typename Policy,
-         typename std::enable_if<std::is_same<typename C::value_type,T>::value>::type* = nullptr>
-    bool matches(Matcher<Policy,T> const& itemMatcher, C const& cont) const {
-        auto pred = std::bind(&Matcher<Policy,T>::template matches<T>, &itemMatcher, std::placeholders::_1);
-        return std::all_of(std::begin(cont), std::end(cont), pred);
-    }
+// SFINAE type trait to detect ranges contains_item doesn't have to scan:
+// those with their own find, and sorted ones
 
-    template<typename T>
-    void describe(std::ostream& o, T const& expected) const {
-       o << "contains " << expected;
-    }
+template<typename C, typename = void>
+struct is_searchable : is_sorted_range<C>
+{ };
 
-    template<typename T, typename Policy>
-    void describe(std::ostream& o, Matcher<Policy,T> const& expected) const {
-       o << "every item " << expected;
-    }
-};
+template<typename C>
+struct is_searchable<C,
+    typename std::enable_if<
+        true,
+        decltype(std::declval<C const&>().find(std::declval<typename range_value<C>::type const&>())
+                 == std::declval<C const&>().end(), (void)0)
+        >::type
+    > : std::true_type
+{ };
 
-template<>
-void IsContaining_::describe(std::ostream& o, std::string const& expected) const {
-   o << "contains " << "\"" << expected << "\"";
+/*
+ * calls visit(n, item, found) for each item of x in turn, found telling
+ * whether y holds it too, until visit returns false. Two sorted ranges
+ * are merged; otherwise each item is looked up in y if it can be searched,
+ * or else in a hash table (a tree for types without std::hash) built from
+ * y's items first. Either way, x and y are only read once.
+ */
+template<typename X, typename Y, typename F>
+typename std::enable_if<is_sorted_range<X>::value && is_sorted_range<Y>::value>::type
+visit_membership(X const& x, Y const& y, F& visit) {
+    auto next = std::begin(y);
+    size_t n = 0;
+    for (auto it = std::begin(x); it != std::end(x); ++it, ++n) {
+        while (next != std::end(y) && *next < *it)
+            ++next;
+        if (!visit(n, *it, next != std::end(y) && !(*it < *next)))
+            return;
+    }
 }
 
-template<class T>
-using IsContaining = Matcher<IsContaining_,T>;
-
-template<typename T>
-constexpr IsContaining<T> contains(T const& value) {
-    return IsContaining<T>(value);
+template<typename X, typename Y, typename F>
+typename std::enable_if<!(is_sorted_range<X>::value && is_sorted_range<Y>::value)
+                        && is_searchable<Y>::value>::type
+visit_membership(X const& x, Y const& y, F& visit) {
+    size_t n = 0;
+    for (auto it = std::begin(x); it != std::end(x); ++it, ++n) {
+        if (!visit(n, *it, contains_item(y, *it, 0)))
+            return;
+    }
 }
 
-template<typename T, size_t N>
-constexpr IsContaining<T[N]> contains(T const (&value)[N]) {
-    return IsContaining<T[N]>(value);
-}
+template<typename X, typename Y, typename F>
+typename std::enable_if<!(is_sorted_range<X>::value && is_sorted_range<Y>::value)
+                        && !is_searchable<Y>::value>::type
+visit_membership(X const& x, Y const& y, F& visit) {
+    typedef typename range_value<Y>::type value_type;
+    typename item_counts<value_type>::type table;
+    for (auto it = std::begin(y); it != std::end(y); ++it)
+        ++table[*it];
 
-template<class Key, class T>
-constexpr IsContaining<std::pair<const Key,T>> contains(Key const& key, T const& value) {
-    return IsContaining<std::pair<const Key,T>>(std::pair<const Key,T>(key, value));
+    size_t n = 0;
+    for (auto it = std::begin(x); it != std::end(x); ++it, ++n) {
+        if (!visit(n, *it, table.count(value_type(*it)) != 0))
+            return;
+    }
 }
 
-template<typename T, typename Policy>
-constexpr IsContaining<Matcher<Policy,T>> everyItem(Matcher<Policy,T> const& itemMatcher) {
-    return IsContaining<Matcher<Policy,T>>(itemMatcher);
-}
+enum class SetRelation { subset, superset, disjoint, intersecting };
 
-struct IsContainingKey {
+/*
+ * the actual collection taken as a set, against the expected one: a
+ * subset or a superset of it, disjoint from it or intersecting it. Matching
+ * stops at the first item deciding the outcome; a mismatch lists at most
+ * 10 of the offending items.
+ */
+template<SetRelation R>
+struct IsSetRelated_ {
 protected:
-    template<typename C, typename T,
-         typename std::enable_if<std::is_same<typename C::key_type,T>::value>::type* = nullptr>
-    bool matches(T const& key, C const& cont) const {
-        for (auto const& val : cont) {
-            if (val.first == key)
-                return true;
-        }
-        return false;
+    template<typename E, typename C>
+    bool matches(E const& expected, C const& actual) const {
+        static_assert(is_range<C>::value, "set matchers are for containers and ranges");
+        FirstHit first;
+        visit(expected, actual, first);
+        return first.found == (R == SetRelation::intersecting);
     }
 
-    template<typename T>
-    void describe(std::ostream& o, T const& expected) const {
-       o << "has key " << expected;
+    template<typename E>
+    void describe(std::ostream& o, E const& expected) const {
+        static const char* const names[] = { "a subset of ", "a superset of ", "disjoint from ", "intersecting " };
+        o << names[int(R)] << expected;
     }
-};
 
-auto hasKey = make_matcher<IsContainingKey>();
+    template<typename E, typename C>
+    void describeMismatch(std::ostream& o, E const& expected, C const& actual) const {
+        if (R == SetRelation::intersecting) {
+            o << "none of " << range_size(actual) << " items in common";
+            return;
+        }
+        static const char* const headings[] = { "unexpected ", "missing ", "in common " };
+        HitPrinter hits(o, headings[int(R)], R != SetRelation::superset);
+        visit(expected, actual, hits);
+        if (hits.count > maxReported)
+            o << ", ... (" << hits.count << " in all)";
+    }
 
-struct IsIn_ {
-protected:
-    template<typename C, typename T,
-         typename std::enable_if<std::is_same<typename C::value_type,T>::value>::type* = nullptr>
-    bool matches(C const& cont, T const& item) const {
-        return std::end(cont) != std::find(std::begin(cont), std::end(cont), item);
+    // a single-pass range can't be read again, neither to list the
+    // offending items nor to count them
+    template<typename E, typename InputIt>
+    void describeMismatch(std::ostream& o, E const&, InputRange<InputIt> const& actual) const {
+        o << actual;
     }
 
-    template<typename T, size_t N>
-    bool matches(T const (&array)[N], T const& item) const {
-        return std::end(array) != std::find(std::begin(array), std::end(array), item);
+private:
+    static constexpr size_t maxReported = 10;
+
+    // whether an item is what the relation looks for: one missing from the
+    // other collection, or for disjoint and intersecting one they share
+    static bool hit(bool found) {
+        return R == SetRelation::disjoint || R == SetRelation::intersecting ? found : !found;
     }
 
-    template<typename C>
-    void describe(std::ostream& o, C const& expected) const {
-       o << "one of " << expected;
+    // a superset is checked by looking up the expected items in the actual collection
+    template<typename E, typename C, typename F>
+    static void visit(E const& expected, C const& actual, F& f) {
+        if (R == SetRelation::superset)
+            visit_membership(expected, actual, f);
+        else
+            visit_membership(actual, expected, f);
     }
 
+    struct FirstHit {
+        bool found = false;
+
+        template<typename T>
+        bool operator()(size_t, T const&, bool member) {
+            found = hit(member);
+            return !found;
+        }
+    };
+
+    struct HitPrinter {
+        HitPrinter(std::ostream& o, const char* heading, bool positions)
+            : o(o), heading(heading), positions(positions), count(0)
+        { }
+
+        template<typename T>
+        bool operator()(size_t n, T const& item, bool member) {
+            if (hit(member) && count++ < maxReported) {
+                o << (count > 1 ? ", " : heading);
+                if (positions)
+                    o << "#" << n << ": ";
+                print_value(o, item);
+            }
+            return true;
+        }
+
+        std::ostream& o;
+        const char* heading;
+        bool positions;
+        size_t count;
+    };
 };
 
 template<typename C>
-using IsIn = Matcher<IsIn_,C>;
+using IsSubsetOf = Matcher<IsSetRelated_<SetRelation::subset>,C>;
+
+template<typename C>
+using IsSupersetOf = Matcher<IsSetRelated_<SetRelation::superset>,C>;
+
+template<typename C>
+using IsDisjointFrom = Matcher<IsSetRelated_<SetRelation::disjoint>,C>;
+
+template<typename C>
+using IsIntersecting = Matcher<IsSetRelated_<SetRelation::intersecting>,C>;
 
 template<typename C>
-constexpr IsIn<C> in(C const& cont) {
-    return IsIn<C>(cont);
+IsSubsetOf<stored_type<C>> subsetOf(C&& items) {
+    return IsSubsetOf<stored_type<C>>(std::forward<C>(items));
 }
 
-template<typename T, typename... Args>
-IsIn<std::vector<T>> oneOf(T const& first, Args const& ... args) {
-    std::vector<T> cont{first, args...};
-    return IsIn<std::vector<T>>(cont);
+template<typename T>
+IsSubsetOf<std::vector<T>> subsetOf(std::initializer_list<T> items) {
+    return IsSubsetOf<std::vector<T>>(std::vector<T>(items));
 }
 
-template<size_t M, size_t... N>
-IsIn<std::vector<std::string>> oneOf(const char (&first)[M], const char (&...args)[N]) {
-    std::vector<std::string> cont{first, args...};
-    return IsIn<std::vector<std::string>>(cont);
+template<typename C>
+IsSupersetOf<stored_type<C>> supersetOf(C&& items) {
+    return IsSupersetOf<stored_type<C>>(std::forward<C>(items));
 }
 
-struct IsEmpty_ {
-protected:
-    template<typename C>
-    bool matches(C const& actual) const {
-        static_assert(pretty_print::is_container<C>::value, "empty matcher is for std containers");
-        return actual.empty();
-    }
+template<typename T>
+IsSupersetOf<std::vector<T>> supersetOf(std::initializer_list<T> items) {
+    return IsSupersetOf<std::vector<T>>(std::vector<T>(items));
+}
 
-    void describe(std::ostream& o) const {
-        o << "an empty container";
-    }
-};
+template<typename C>
+IsDisjointFrom<stored_type<C>> disjointFrom(C&& items) {
+    return IsDisjointFrom<stored_type<C>>(std::forward<C>(items));
+}
 
-using IsEmpty = Matcher<IsEmpty_>;
+template<typename T>
+IsDisjointFrom<std::vector<T>> disjointFrom(std::initializer_list<T> items) {
+    return IsDisjointFrom<std::vector<T>>(std::vector<T>(items));
+}
 
-constexpr IsEmpty empty() {
-    return IsEmpty();
+template<typename C>
+IsIntersecting<stored_type<C>> intersects(C&& items) {
+    return IsIntersecting<stored_type<C>>(std::forward<C>(items));
+}
+
+template<typename T>
+IsIntersecting<std::vector<T>> intersects(std::initializer_list<T> items) {
+    return IsIntersecting<std::vector<T>>(std::vector<T>(items));
 }
 
 struct IsEmptyString_ {
 protected:
-    bool matches(std::string const& actual) const {
+    bool matches(string_ref actual) const {
         return actual.empty();
     }
 
@@ -624,12 +2407,9 @@ constexpr IsEmptyString emptyString() {
 
 struct IsEqualIgnoringCase_ {
 protected:
-    bool matches(std::string const& expected, std::string const& actual) const {
-        ci_string ci_exp, ci_act;
-
-        ci_exp.assign(expected.begin(), expected.end());
-        ci_act.assign(actual.begin(), actual.end());
-        return ci_exp == ci_act;
+    bool matches(std::string const& expected, string_ref actual) const {
+        return expected.size() == actual.size()
+            && !ci_char_traits::compare(expected.data(), actual.data(), actual.size());
     }
 
     void describe(std::ostream& o, std::string const& expected) const {
@@ -645,18 +2425,20 @@ IsEqualIgnoringCase equalToIgnoringCase(std::string const& val) {
 
 struct IsEqualIgnoringWhiteSpace_ {
 protected:
-    bool matches(std::string const& expected, std::string const& actual) const {
-        std::string exp(expected), act(actual);
-
-        exp.erase(std::remove_if(exp.begin(),
-                                 exp.end(),
-                                 [](char x){return std::isspace(x);}),
-                  exp.end());
-        act.erase(std::remove_if(act.begin(),
-                                 act.end(),
-                                 [](char x){return std::isspace(x);}),
-                  act.end());
-        return exp == act;
+    // compares the two strings skipping white space, without copying them
+    bool matches(std::string const& expected, string_ref actual) const {
+        auto space = [](char x) { return std::isspace(static_cast<unsigned char>(x)) != 0; };
+        auto e = expected.begin();
+        auto a = actual.begin();
+
+        for (;;) {
+            e = std::find_if_not(e, expected.end(), space);
+            a = std::find_if_not(a, actual.end(), space);
+            if (e == expected.end() || a == actual.end())
+                return e == expected.end() && a == actual.end();
+            if (*e++ != *a++)
+                return false;
+        }
     }
 
     void describe(std::ostream& o, std::string const& expected) const {
@@ -670,15 +2452,172 @@ IsEqualIgnoringWhiteSpace equalToIgnoringWhiteSpace(std::string const& val) {
     return IsEqualIgnoringWhiteSpace(val);
 }
 
+/*
+ * a string along with the bit masks of Myers' bit-parallel edit distance
+ * algorithm (in Hyyrö's formulation): for every character, the positions
+ * at which it occurs in the string, one bit per position, in as many
+ * 64-bit blocks as needed. They are computed once, when the matcher is
+ * built, and a text is then processed a whole block at a time.
+ */
+class FuzzyPattern {
+public:
+    FuzzyPattern(std::string const& text, size_t k)
+        : text_(text), k_(k), blocks_((text.size() + 63) / 64), peq_(256 * blocks_, 0)
+    {
+        for (size_t i = 0; i < text.size(); ++i)
+            peq_[static_cast<unsigned char>(text[i]) * blocks_ + i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    std::string const& text() const { return text_; }
+    size_t k() const { return k_; }
+
+    // Levenshtein distance between the pattern and the whole of s
+    size_t distance(string_ref s) const {
+        return scan(s, true, 0);
+    }
+
+    // least distance between the pattern and any substring of s; stops
+    // looking once it finds one of at most `enough`
+    size_t bestMatch(string_ref s, size_t enough = 0) const {
+        return scan(s, false, enough);
+    }
+
+private:
+    /*
+     * one column of the dynamic programming matrix for a block of rows,
+     * kept as vertical deltas (pv: +1, mv: -1). hin is the horizontal delta
+     * entering the top row, and the one leaving row `out` is returned.
+     */
+    static int advance(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin, unsigned out) {
+        uint64_t hinNeg = hin < 0 ? 1 : 0;
+        uint64_t xv = eq | mv;
+        eq |= hinNeg;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        int hout = int((ph >> out) & 1) - int((mh >> out) & 1);
+        ph = (ph << 1) | (hin > 0 ? 1 : 0);
+        mh = (mh << 1) | hinNeg;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        return hout;
+    }
+
+    // with global set, the top row grows by one per character of s (an
+    // alignment of the whole of s), otherwise it's all zeroes (a search)
+    size_t scan(string_ref s, bool global, size_t enough) const {
+        size_t m = text_.size();
+        if (!blocks_)
+            return global ? s.size() : 0;
+
+        // patterns of up to 512 characters are handled without allocating
+        uint64_t local[2 * localBlocks];
+        std::vector<uint64_t> heap;
+        uint64_t* pv = local;
+        if (blocks_ > localBlocks) {
+            heap.resize(2 * blocks_);
+            pv = heap.data();
+        }
+        uint64_t* mv = pv + blocks_;
+        std::fill(pv, pv + blocks_, ~uint64_t(0));
+        std::fill(mv, mv + blocks_, uint64_t(0));
+
+        unsigned last = unsigned((m - 1) % 64);
+        size_t score = m, best = m;
+
+        for (size_t j = 0; j < s.size() && (global || best > enough); ++j) {
+            const uint64_t* eq = &peq_[static_cast<unsigned char>(s.data()[j]) * blocks_];
+            int h = global ? 1 : 0;
+            for (size_t b = 0; b < blocks_; ++b)
+                h = advance(pv[b], mv[b], eq[b], h, b + 1 == blocks_ ? last : 63);
+            score += h;
+            best = std::min(best, score);
+        }
+        return global ? score : best;
+    }
+
+    static constexpr size_t localBlocks = 8;
+
+    std::string text_;
+    size_t k_;
+    size_t blocks_;
+    std::vector<uint64_t> peq_;
+};
+
+inline std::ostream& operator<<(std::ostream& o, FuzzyPattern const& pattern) {
+    return o << "\"" << pattern.text() << "\"";
+}
+
+struct WithinEditDistance_ {
+protected:
+    bool matches(FuzzyPattern const& expected, string_ref actual) const {
+        size_t m = expected.text().size();
+        size_t diff = m > actual.size() ? m - actual.size() : actual.size() - m;
+        return diff <= expected.k() && expected.distance(actual) <= expected.k();
+    }
+
+    void describe(std::ostream& o, FuzzyPattern const& expected) const {
+       o << "a string within edit distance " << expected.k() << " of " << expected;
+    }
+
+    void describeMismatch(std::ostream& o, FuzzyPattern const& expected, string_ref actual) const {
+       o << "\"" << actual << "\", at edit distance " << expected.distance(actual);
+    }
+};
+
+using WithinEditDistance = Matcher<WithinEditDistance_,FuzzyPattern>;
+
+inline WithinEditDistance withinEditDistance(std::string const& expected, size_t k) {
+    return WithinEditDistance(FuzzyPattern(expected, k));
+}
+
+struct ContainsApproximately_ {
+protected:
+    bool matches(FuzzyPattern const& needle, string_ref actual) const {
+        return needle.bestMatch(actual, needle.k()) <= needle.k();
+    }
+
+    void describe(std::ostream& o, FuzzyPattern const& needle) const {
+       o << "a string containing " << needle << " with at most " << needle.k() << " edits";
+    }
+
+    void describeMismatch(std::ostream& o, FuzzyPattern const& needle, string_ref actual) const {
+       o << "\"" << actual << "\", where the closest match takes " << needle.bestMatch(actual) << " edits";
+    }
+};
+
+using ContainsApproximately = Matcher<ContainsApproximately_,FuzzyPattern>;
+
+inline ContainsApproximately containsApproximately(std::string const& needle, size_t k) {
+    return ContainsApproximately(FuzzyPattern(needle, k));
+}
+
 struct StringStartsWith_ {
 protected:
     bool matches(std::string const& substr, std::string const& actual) const {
         return !actual.compare(0, substr.size(), substr);
     }
 
+    bool matches(string_ref substr, string_ref actual) const {
+        return actual.size() >= substr.size()
+            && std::equal(substr.begin(), substr.end(), actual.begin());
+    }
+
+    template<char... Cs>
+    bool matches(literal<Cs...> const&, string_ref actual) const {
+        return actual.size() >= sizeof...(Cs)
+            && !std::memcmp(actual.data(), literal<Cs...>::value, sizeof...(Cs));
+    }
+
     void describe(std::ostream& o, std::string const& expected) const {
        o << "starts with " << "\"" << expected << "\"";
     }
+
+    template<char... Cs>
+    void describe(std::ostream& o, literal<Cs...> const& expected) const {
+       o << "starts with " << "\"" << expected << "\"";
+    }
 };
 
 using StringStartsWith = Matcher<StringStartsWith_,std::string>;
@@ -687,15 +2626,36 @@ StringStartsWith startsWith(std::string const& val) {
     return StringStartsWith(val);
 }
 
+template<char... Cs>
+constexpr Matcher<StringStartsWith_,literal<Cs...>> startsWith(literal<Cs...> const& val) {
+    return Matcher<StringStartsWith_,literal<Cs...>>(val);
+}
+
 struct StringEndsWith_ {
 protected:
     bool matches(std::string const& substr, std::string const& actual) const {
         return !actual.compare(actual.size() - substr.size(), substr.size(), substr);
     }
 
+    bool matches(string_ref substr, string_ref actual) const {
+        return actual.size() >= substr.size()
+            && std::equal(substr.begin(), substr.end(), actual.end() - substr.size());
+    }
+
+    template<char... Cs>
+    bool matches(literal<Cs...> const&, string_ref actual) const {
+        return actual.size() >= sizeof...(Cs)
+            && !std::memcmp(actual.end() - sizeof...(Cs), literal<Cs...>::value, sizeof...(Cs));
+    }
+
     void describe(std::ostream& o, std::string const& expected) const {
        o << "ends with " << "\"" << expected << "\"";
     }
+
+    template<char... Cs>
+    void describe(std::ostream& o, literal<Cs...> const& expected) const {
+       o << "ends with " << "\"" << expected << "\"";
+    }
 };
 
 using StringEndsWith = Matcher<StringEndsWith_,std::string>;
@@ -704,16 +2664,49 @@ StringEndsWith endsWith(std::string const& val) {
     return StringEndsWith(val);
 }
 
+template<char... Cs>
+constexpr Matcher<StringEndsWith_,literal<Cs...>> endsWith(literal<Cs...> const& val) {
+    return Matcher<StringEndsWith_,literal<Cs...>>(val);
+}
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+// C++20 spelling of the literal matchers: startsWith<"GET ">()
+template<size_t N>
+struct fixed_string {
+    constexpr fixed_string(char const (&s)[N]) {
+        std::copy(s, s + N, data);
+    }
+    char data[N];
+};
+
+template<fixed_string S, size_t... I>
+constexpr literal<S.data[I]...> to_literal(std::index_sequence<I...>) {
+    return literal<S.data[I]...>();
+}
+
+template<fixed_string S>
+constexpr auto startsWith() {
+    return startsWith(to_literal<S>(std::make_index_sequence<sizeof(S.data) - 1>()));
+}
+
+template<fixed_string S>
+constexpr auto endsWith() {
+    return endsWith(to_literal<S>(std::make_index_sequence<sizeof(S.data) - 1>()));
+}
+
+#endif
+
 struct AnyOf_ {
 protected:
     template<class ActualType, std::size_t I = 0, typename... Tp>
-    typename std::enable_if<I == sizeof...(Tp), bool>::type
+    constexpr typename std::enable_if<I == sizeof...(Tp), bool>::type
     matches(std::tuple<Tp...> const& t, ActualType const& actual) const {
         return false;
     }
 
     template<class ActualType, std::size_t I = 0, typename... Tp>
-    typename std::enable_if<I < sizeof...(Tp), bool>::type
+    constexpr typename std::enable_if<I < sizeof...(Tp), bool>::type
     matches(std::tuple<Tp...> const& t, ActualType const& actual) const {
         return std::get<I>(t).matches(actual) || matches<ActualType, I + 1, Tp...>(t, actual);
     }
@@ -743,22 +2736,23 @@ template<typename T>
 using AnyOf = Matcher<AnyOf_,T>;
 
 template<typename First, typename... Args>
-constexpr AnyOf<std::tuple<First,Args...>> anyOf(First first, Args... args)
+constexpr AnyOf<std::tuple<stored_type<First>,stored_type<Args>...>> anyOf(First&& first, Args&&... args)
 {
-    static_assert(is_matcher<First, Args...>::value, "anyOf requires Matcher parameters");
-    return AnyOf<std::tuple<First,Args...>>(std::make_tuple(first, args...));
+    static_assert(is_matcher<stored_type<First>, stored_type<Args>...>::value, "anyOf requires Matcher parameters");
+    return AnyOf<std::tuple<stored_type<First>,stored_type<Args>...>>(
+        std::tuple<stored_type<First>,stored_type<Args>...>(std::forward<First>(first), std::forward<Args>(args)...));
 }
 
 struct AllOf_ {
 protected:
     template<class ActualType, std::size_t I = 0, typename... Tp>
-    typename std::enable_if<I == sizeof...(Tp), bool>::type
+    constexpr typename std::enable_if<I == sizeof...(Tp), bool>::type
     matches(std::tuple<Tp...> const& t, ActualType const& actual) const {
         return true;
     }
 
     template<class ActualType, std::size_t I = 0, typename... Tp>
-    typename std::enable_if<I < sizeof...(Tp), bool>::type
+    constexpr typename std::enable_if<I < sizeof...(Tp), bool>::type
     matches(std::tuple<Tp...> const& t, ActualType const& actual) const {
         return std::get<I>(t).matches(actual) && matches<ActualType, I + 1, Tp...>(t, actual);
     }
@@ -788,25 +2782,26 @@ template<typename T>
 using AllOf = Matcher<AllOf_,T>;
 
 template<typename First, typename... Args>
-constexpr AllOf<std::tuple<First,Args...>> allOf(First first, Args... args)
+constexpr AllOf<std::tuple<stored_type<First>,stored_type<Args>...>> allOf(First&& first, Args&&... args)
 {
-    static_assert(is_matcher<First, Args...>::value, "allOf requires Matcher parameters");
-    return AllOf<std::tuple<First,Args...>>(std::make_tuple(first, args...));
+    static_assert(is_matcher<stored_type<First>, stored_type<Args>...>::value, "allOf requires Matcher parameters");
+    return AllOf<std::tuple<stored_type<First>,stored_type<Args>...>>(
+        std::tuple<stored_type<First>,stored_type<Args>...>(std::forward<First>(first), std::forward<Args>(args)...));
 }
 
 struct IsCloseTo_ {
     template<typename T>
-    bool matches (std::pair<T,T> const& expected, T const& actual) const {
-        T value = expected.first;
-        T delta = expected.second;
-
-        return std::fabs(actual - value) <= delta;
+    constexpr bool matches (std::pair<T,T> const& expected, T const& actual) const {
+        return actual - expected.first <= expected.second
+            && expected.first - actual <= expected.second;
     }
 
     template<typename T>
     void describe(std::ostream& o, std::pair<T,T> const& expected) const {
-       o << "a numeric value within +/-" << expected.second
-         << " of " << expected.first;
+       o << "a numeric value within +/-";
+       print_value(o, expected.second);
+       o << " of ";
+       print_value(o, expected.first);
     }
 };
 
@@ -817,21 +2812,34 @@ template<typename T>
 constexpr IsCloseTo<std::pair<T,T>> closeTo(T const& operand, T const& error) {
     static_assert(std::is_floating_point<T>::value, 
                   "closeTo parameters need be floating-point type");
-    return IsCloseTo<std::pair<T,T>>(std::make_pair(operand, error));
+    return IsCloseTo<std::pair<T,T>>(std::pair<T,T>(operand, error));
 }
 
 
+// a regular expression along with its source, compiled once by the matcher
+struct Pattern {
+    Pattern(std::string const& source) : source(source), regex(source)
+    { }
+
+    std::string source;
+    std::regex regex;
+};
+
 struct MatchesPattern_ {
-    bool matches(std::string const& reg, std::string const& actual) const {
-        return std::regex_match(actual, std::regex(reg));
+    bool matches(Pattern const& pattern, std::string const& actual) const {
+        return std::regex_match(actual, pattern.regex);
     }
 
-    void describe(std::ostream& o, std::string const& expected) const {
-       o << "a string matching the pattern " << expected;
+    bool matches(Pattern const& pattern, string_ref actual) const {
+        return std::regex_match(actual.begin(), actual.end(), pattern.regex);
+    }
+
+    void describe(std::ostream& o, Pattern const& expected) const {
+       o << "a string matching the pattern " << expected.source;
     }
 };
 
-using MatchesPattern = Matcher<MatchesPattern_,std::string>;
+using MatchesPattern = Matcher<MatchesPattern_,Pattern>;
 
 MatchesPattern matchesPattern(std::string const& reg_exp) {
     return MatchesPattern(reg_exp);
@@ -841,68 +2849,122 @@ MatchesPattern matches(std::string const& reg_exp) {
     return MatchesPattern(reg_exp);
 }
 
-template<typename F>
+// comparison functions for OrderingComparison; unlike std::less and friends,
+// they are constexpr in C++11 too
+
+struct Less {
+    template<typename T>
+    static constexpr bool compare(T const& a, T const& b) { return a < b; }
+};
+
+struct Greater {
+    template<typename T>
+    static constexpr bool compare(T const& a, T const& b) { return a > b; }
+};
+
+struct LessEqual {
+    template<typename T>
+    static constexpr bool compare(T const& a, T const& b) { return a <= b; }
+};
+
+struct GreaterEqual {
+    template<typename T>
+    static constexpr bool compare(T const& a, T const& b) { return a >= b; }
+};
+
+template<typename Compare>
 struct OrderingComparison {
 protected:
     template<typename T>
-    bool matches(T const& expected, T const& actual) const {
-        F op = F();
-        return op(actual, expected);
+    constexpr bool matches(T const& expected, T const& actual) const {
+        return Compare::compare(actual, expected);
     }
 };
 
 template<typename T>
-struct LessThan : OrderingComparison<std::less<T>> {
+struct LessThan : OrderingComparison<Less> {
 protected:
     void describe(std::ostream& o, T const& expected) const {
-        o << "less than " << expected;
+        o << "less than ";
+        print_value(o, expected);
     }
 };
 
 template<typename T>
-Matcher<LessThan<T>,T> lessThan(T const& value) {
+constexpr Matcher<LessThan<T>,T> lessThan(T const& value) {
     return Matcher<LessThan<T>,T>(value);
 }
 
 template<typename T>
-struct GreaterThan : OrderingComparison<std::greater<T>> {
+struct GreaterThan : OrderingComparison<Greater> {
 protected:
     void describe(std::ostream& o, T const& expected) const {
-        o << "greater than " << expected;
+        o << "greater than ";
+        print_value(o, expected);
     }
 };
 
 template<typename T>
-Matcher<GreaterThan<T>,T> greaterThan(T const& value) {
+constexpr Matcher<GreaterThan<T>,T> greaterThan(T const& value) {
     return Matcher<GreaterThan<T>,T>(value);
 }
 
 template<typename T>
-struct GreaterThanOrEqual : OrderingComparison<std::greater_equal<T>> {
+struct GreaterThanOrEqual : OrderingComparison<GreaterEqual> {
 protected:
     void describe(std::ostream& o, T const& expected) const {
-        o << "greater than or equal to " << expected;
+        o << "greater than or equal to ";
+        print_value(o, expected);
     }
 };
 
 template<typename T>
-Matcher<GreaterThanOrEqual<T>,T> greaterThanOrEqualTo(T const& value) {
+constexpr Matcher<GreaterThanOrEqual<T>,T> greaterThanOrEqualTo(T const& value) {
     return Matcher<GreaterThanOrEqual<T>,T>(value);
 }
 
 template<typename T>
-struct LessThanOrEqual : OrderingComparison<std::less_equal<T>> {
+struct LessThanOrEqual : OrderingComparison<LessEqual> {
 protected:
     void describe(std::ostream& o, T const& expected) const {
-        o << "less than or equal to " << expected;
+        o << "less than or equal to ";
+        print_value(o, expected);
     }
 };
 
 template<typename T>
-Matcher<LessThanOrEqual<T>,T> lessThanOrEqualTo(T const& value) {
+constexpr Matcher<LessThanOrEqual<T>,T> lessThanOrEqualTo(T const& value) {
     return Matcher<LessThanOrEqual<T>,T>(value);
 }
 
+// bounds on a count, e.g. calledTimes(atLeast(2))
+
+template<typename T>
+struct AtLeast : OrderingComparison<GreaterEqual> {
+protected:
+    void describe(std::ostream& o, T const& expected) const {
+        o << "at least ";
+        print_value(o, expected);
+    }
+};
+
+constexpr Matcher<AtLeast<size_t>,size_t> atLeast(size_t k) {
+    return Matcher<AtLeast<size_t>,size_t>(k);
+}
+
+template<typename T>
+struct AtMost : OrderingComparison<LessEqual> {
+protected:
+    void describe(std::ostream& o, T const& expected) const {
+        o << "at most ";
+        print_value(o, expected);
+    }
+};
+
+constexpr Matcher<AtMost<size_t>,size_t> atMost(size_t k) {
+    return Matcher<AtMost<size_t>,size_t>(k);
+}
+
 } // namespace matcha
 
 #endif // _MATCHA_H_
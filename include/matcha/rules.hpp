@@ -0,0 +1,563 @@
+/* vim: set sw=4 ts=4 et : */
+/* rules.hpp: matchers read at runtime, compiled to bytecode
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_RULES_H_
+#define _MATCHA_RULES_H_
+
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include "matcha.hpp"
+
+namespace matcha {
+
+// a rule that doesn't compile, and the column (from 1) the error is at
+class RuleError : public std::runtime_error {
+public:
+    RuleError(std::string const& message, size_t column)
+        : std::runtime_error("column " + std::to_string(column) + ": " + message), column_(column)
+    { }
+
+    size_t column() const { return column_; }
+
+private:
+    size_t column_;
+};
+
+/*
+ * a matcher expression read at runtime, e.g. from a config file, in the
+ * vocabulary of the matchers themselves:
+ *
+ *   allOf(startsWith("GET "), not(contains("..")), anyOf(endsWith("HTTP/1.1"), endsWith("HTTP/2")))
+ *   anyOf(equalTo(0), closeTo(100, 0.5), greaterThanOrEqualTo(1e6))
+ *
+ * The expression is compiled into a flat program: one 32-bit instruction
+ * per matcher (an opcode and the index of its operand), numbers and
+ * strings in constant pools, and patterns compiled once into a table.
+ * anyOf and allOf become jumps, so they stop at the first child deciding
+ * the outcome. Running it is a single loop over the instructions, with
+ * one boolean register.
+ *
+ * Values are strings or numbers. Numeric matchers read a string as a
+ * number (and fail on one that isn't), string matchers read a number as
+ * its decimal text; numbers are compared as doubles.
+ */
+class RuleProgram {
+public:
+    enum Op : uint8_t {
+        Halt, Not, JumpIfTrue, JumpIfFalse,
+        NumEq, NumLt, NumGt, NumLe, NumGe, NumClose,
+        StrEq, StrLt, StrGt, StrLe, StrGe,
+        StartsWith, EndsWith, Contains, EqualIgnoringCase, Regex, Empty
+    };
+
+    static RuleProgram compile(std::string const& source);
+
+    bool run(string_ref text) const {
+        Subject s{ text, 0, false };
+        if (code_->numeric)
+            s.numeric = parse_number(text, s.number);
+        return execute(s);
+    }
+
+    template<typename T>
+    typename std::enable_if<is_number<T>::value, bool>::type
+    run(T number) const {
+        char buf[max_number_length];
+        Subject s{ string_ref(), double(number), true };
+        if (code_->textual)
+            s.text = string_ref(buf, format_number(buf, number));
+        return execute(s);
+    }
+
+    std::string const& source() const { return code_->source; }
+
+    // what the equivalent matcher would print
+    std::string const& description() const { return code_->description; }
+
+    // number of instructions
+    size_t size() const { return code_->code.size(); }
+
+private:
+    friend class RuleCompiler;
+
+    struct Code {
+        std::string source;
+        std::string description;
+        std::vector<uint32_t> code;
+        std::vector<double> numbers;
+        std::string strings;                                // string constants, back to back
+        std::vector<std::pair<uint32_t,uint32_t>> stringRefs;  // offset and size in strings
+        std::vector<std::regex> regexes;
+        bool numeric;   // whether the subject is ever read as a number
+        bool textual;   // or as a string
+    };
+
+    struct Subject {
+        string_ref text;
+        double number;
+        bool numeric;
+    };
+
+    explicit RuleProgram(std::shared_ptr<Code const> code) : code_(std::move(code))
+    { }
+
+    static bool parse_number(string_ref text, double& number) {
+        char buf[64];
+        if (text.empty() || text.size() >= sizeof buf)
+            return false;
+        std::memcpy(buf, text.data(), text.size());
+        buf[text.size()] = '\0';
+        char* end;
+        number = std::strtod(buf, &end);
+        return end == buf + text.size();
+    }
+
+    static int compare(string_ref a, string_ref b) {
+        int order = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+        return order ? order : (a.size() < b.size() ? -1 : a.size() > b.size());
+    }
+
+    bool execute(Subject const& s) const {
+        Code const& c = *code_;
+        const uint32_t* code = c.code.data();
+        const uint32_t* pc = code;
+        const double* numbers = c.numbers.data();
+        bool acc = false;
+
+        for (;;) {
+            uint32_t instruction = *pc++;
+            uint32_t arg = instruction >> 8;
+            switch (Op(instruction & 0xff)) {
+            case Halt:
+                return acc;
+            case Not:
+                acc = !acc;
+                break;
+            case JumpIfTrue:
+                if (acc)
+                    pc = code + arg;
+                break;
+            case JumpIfFalse:
+                if (!acc)
+                    pc = code + arg;
+                break;
+            case NumEq:
+                acc = s.numeric && s.number == numbers[arg];
+                break;
+            case NumLt:
+                acc = s.numeric && s.number < numbers[arg];
+                break;
+            case NumGt:
+                acc = s.numeric && s.number > numbers[arg];
+                break;
+            case NumLe:
+                acc = s.numeric && s.number <= numbers[arg];
+                break;
+            case NumGe:
+                acc = s.numeric && s.number >= numbers[arg];
+                break;
+            case NumClose:
+                acc = s.numeric && s.number - numbers[arg] <= numbers[arg + 1]
+                                && numbers[arg] - s.number <= numbers[arg + 1];
+                break;
+            case StrEq:
+                acc = s.text == constant(arg);
+                break;
+            case StrLt:
+                acc = compare(s.text, constant(arg)) < 0;
+                break;
+            case StrGt:
+                acc = compare(s.text, constant(arg)) > 0;
+                break;
+            case StrLe:
+                acc = compare(s.text, constant(arg)) <= 0;
+                break;
+            case StrGe:
+                acc = compare(s.text, constant(arg)) >= 0;
+                break;
+            case StartsWith: {
+                string_ref prefix = constant(arg);
+                acc = s.text.size() >= prefix.size()
+                    && !std::memcmp(s.text.data(), prefix.data(), prefix.size());
+                break;
+            }
+            case EndsWith: {
+                string_ref suffix = constant(arg);
+                acc = s.text.size() >= suffix.size()
+                    && !std::memcmp(s.text.end() - suffix.size(), suffix.data(), suffix.size());
+                break;
+            }
+            case Contains:
+                acc = s.text.find(constant(arg)) != std::string::npos;
+                break;
+            case EqualIgnoringCase: {
+                string_ref expected = constant(arg);
+                acc = s.text.size() == expected.size()
+                    && !ci_char_traits::compare(s.text.data(), expected.data(), expected.size());
+                break;
+            }
+            case Regex:
+                acc = std::regex_match(s.text.begin(), s.text.end(), c.regexes[arg]);
+                break;
+            case Empty:
+                acc = s.text.empty();
+                break;
+            }
+        }
+    }
+
+    string_ref constant(uint32_t index) const {
+        auto const& ref = code_->stringRefs[index];
+        return string_ref(code_->strings.data() + ref.first, ref.second);
+    }
+
+    std::shared_ptr<Code const> code_;
+};
+
+/*
+ * one pass over the source: a recursive descent parser emitting the code
+ * and the description of each matcher as it goes, patching the jumps of
+ * anyOf and allOf once their last child is compiled
+ *
+ *   rule    := matcher
+ *   matcher := name [ "(" [ arg { "," arg } ] ")" ]
+ *   arg     := matcher | number | string
+ */
+class RuleCompiler {
+public:
+    explicit RuleCompiler(std::string const& source) : source_(source), pos_(0)
+    {
+        code_.source = source;
+        code_.numeric = false;
+        code_.textual = false;
+    }
+
+    RuleProgram compile() {
+        FormatBuffer buffer;
+        FormatStream description(buffer);
+        matcher(description);
+        skip();
+        if (pos_ != source_.size())
+            error("unexpected characters after the rule");
+        emit(RuleProgram::Halt);
+        code_.description = buffer.str();
+        return RuleProgram(std::make_shared<RuleProgram::Code const>(std::move(code_)));
+    }
+
+private:
+    typedef RuleProgram::Op Op;
+
+    struct Literal {
+        size_t column;
+        bool isString;
+        bool isIntegral;
+        double number;
+        std::string text;
+    };
+
+    static constexpr uint32_t maxOperand = (1u << 24) - 1;
+
+    void matcher(std::ostream& d) {
+        skip();
+        size_t at = pos_ + 1;
+        std::string name = identifier();
+
+        if (name == "is" || name == "not") {
+            d << name << " ";
+            expect('(');
+            matcher(d);
+            expect(')');
+            if (name == "not")
+                emit(RuleProgram::Not);
+            return;
+        }
+
+        if (name == "anyOf" || name == "allOf") {
+            bool any = name == "anyOf";
+            d << (any ? "any of " : "all of ");
+            expect('(');
+            std::vector<size_t> jumps;
+            for (;;) {
+                matcher(d);
+                if (!accept(','))
+                    break;
+                d << (any ? " or " : " and ");
+                jumps.push_back(emit(any ? RuleProgram::JumpIfTrue : RuleProgram::JumpIfFalse));
+            }
+            expect(')');
+            d << ".";
+            for (size_t jump : jumps)
+                patch(jump, code_.code.size());
+            return;
+        }
+
+        std::vector<Literal> args;
+        if (accept('(') && !accept(')')) {
+            do
+                args.push_back(literal());
+            while (accept(','));
+            expect(')');
+        }
+        leaf(name, at, args, d);
+    }
+
+    void leaf(std::string const& name, size_t at, std::vector<Literal> const& args, std::ostream& d) {
+        if (name == "equalTo") {
+            Literal const& v = single(name, at, args);
+            if (v.isString) {
+                d << "\"" << v.text << "\"";
+                emit(RuleProgram::StrEq, string_constant(v));
+            }
+            else {
+                print(d, v);
+                emit(RuleProgram::NumEq, number_constant(v.number));
+            }
+        }
+        else if (name == "lessThan" || name == "greaterThan"
+                 || name == "lessThanOrEqualTo" || name == "greaterThanOrEqualTo") {
+            Literal const& v = single(name, at, args);
+            static const struct { const char* name; const char* text; Op num, str; } orders[] = {
+                { "lessThan", "less than ", RuleProgram::NumLt, RuleProgram::StrLt },
+                { "greaterThan", "greater than ", RuleProgram::NumGt, RuleProgram::StrGt },
+                { "lessThanOrEqualTo", "less than or equal to ", RuleProgram::NumLe, RuleProgram::StrLe },
+                { "greaterThanOrEqualTo", "greater than or equal to ", RuleProgram::NumGe, RuleProgram::StrGe },
+            };
+            for (auto const& order : orders) {
+                if (name != order.name)
+                    continue;
+                d << order.text;
+                print(d, v);
+                if (v.isString)
+                    emit(order.str, string_constant(v));
+                else
+                    emit(order.num, number_constant(v.number));
+            }
+        }
+        else if (name == "closeTo") {
+            if (args.size() != 2 || args[0].isString || args[1].isString)
+                error("closeTo takes two numbers", at);
+            d << "a numeric value within +/-";
+            print(d, args[1]);
+            d << " of ";
+            print(d, args[0]);
+            size_t operand = number_constant(args[0].number);
+            number_constant(args[1].number);
+            emit(RuleProgram::NumClose, operand);
+        }
+        else if (name == "startsWith" || name == "endsWith" || name == "contains") {
+            Literal const& v = string_argument(name, at, args);
+            d << (name == "startsWith" ? "starts with " : name == "endsWith" ? "ends with " : "contains ")
+              << "\"" << v.text << "\"";
+            emit(name == "startsWith" ? RuleProgram::StartsWith
+                 : name == "endsWith" ? RuleProgram::EndsWith : RuleProgram::Contains, string_constant(v));
+        }
+        else if (name == "equalToIgnoringCase") {
+            Literal const& v = string_argument(name, at, args);
+            d << "Equal to " << "\"" << v.text << "\"" << " ignoring case";
+            emit(RuleProgram::EqualIgnoringCase, string_constant(v));
+        }
+        else if (name == "matches" || name == "matchesPattern") {
+            Literal const& v = string_argument(name, at, args);
+            d << "a string matching the pattern " << v.text;
+            try {
+                code_.regexes.emplace_back(v.text);
+            }
+            catch (std::regex_error const& e) {
+                error(std::string("bad pattern: ") + e.what(), v.column);
+            }
+            code_.textual = true;
+            emit(RuleProgram::Regex, code_.regexes.size() - 1);
+        }
+        else if (name == "emptyString") {
+            if (!args.empty())
+                error("emptyString takes no arguments", at);
+            d << "an empty string";
+            code_.textual = true;
+            emit(RuleProgram::Empty);
+        }
+        else
+            error("unknown matcher '" + name + "'", at);
+    }
+
+    Literal const& single(std::string const& name, size_t at, std::vector<Literal> const& args) {
+        if (args.size() != 1)
+            error(name + " takes one argument", at);
+        return args[0];
+    }
+
+    Literal const& string_argument(std::string const& name, size_t at, std::vector<Literal> const& args) {
+        Literal const& v = single(name, at, args);
+        if (!v.isString)
+            error(name + " takes a string", v.column);
+        return v;
+    }
+
+    static void print(std::ostream& d, Literal const& v) {
+        if (v.isString)
+            d << v.text;
+        else if (v.isIntegral)
+            print_value(d, static_cast<long long>(v.number));
+        else
+            print_value(d, v.number);
+    }
+
+    // the index of a number in the pool
+    size_t number_constant(double value) {
+        code_.numeric = true;
+        code_.numbers.push_back(value);
+        return code_.numbers.size() - 1;
+    }
+
+    // the index of a string in the pool
+    size_t string_constant(Literal const& v) {
+        code_.textual = true;
+        if (code_.strings.size() + v.text.size() > 0xffffffffu)
+            error("too many strings", v.column);
+        code_.stringRefs.push_back(std::make_pair(uint32_t(code_.strings.size()), uint32_t(v.text.size())));
+        code_.strings += v.text;
+        return code_.stringRefs.size() - 1;
+    }
+
+    size_t emit(Op op, size_t operand = 0) {
+        if (operand > maxOperand)
+            error("rule too large");
+        code_.code.push_back(uint32_t(op) | uint32_t(operand) << 8);
+        return code_.code.size() - 1;
+    }
+
+    void patch(size_t jump, size_t target) {
+        if (target > maxOperand)
+            error("rule too large");
+        code_.code[jump] = (code_.code[jump] & 0xff) | uint32_t(target) << 8;
+    }
+
+    Literal literal() {
+        skip();
+        Literal v{ pos_ + 1, false, false, 0, std::string() };
+        if (pos_ == source_.size())
+            error("expected a value");
+
+        char c = source_[pos_];
+        if (c == '"') {
+            v.isString = true;
+            for (++pos_; pos_ < source_.size() && source_[pos_] != '"'; ++pos_) {
+                c = source_[pos_];
+                if (c == '\\' && ++pos_ < source_.size()) {
+                    c = source_[pos_];
+                    c = c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c;
+                }
+                v.text += c;
+            }
+            if (pos_ == source_.size())
+                error("unterminated string", v.column);
+            ++pos_;
+            return v;
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.') {
+            const char* begin = source_.c_str() + pos_;
+            char* end;
+            v.number = std::strtod(begin, &end);
+            if (end == begin)
+                error("expected a value");
+            v.isIntegral = std::find_if(begin, static_cast<const char*>(end), [](char ch) {
+                return ch == '.' || ch == 'e' || ch == 'E' || std::isalpha(static_cast<unsigned char>(ch));
+            }) == end && v.number > -9.2e18 && v.number < 9.2e18;
+            pos_ += end - begin;
+            return v;
+        }
+
+        error("expected a number or a string");
+        return v;
+    }
+
+    std::string identifier() {
+        skip();
+        size_t begin = pos_;
+        while (pos_ < source_.size()
+               && (std::isalnum(static_cast<unsigned char>(source_[pos_])) || source_[pos_] == '_'))
+            ++pos_;
+        if (begin == pos_)
+            error("expected a matcher");
+        return source_.substr(begin, pos_ - begin);
+    }
+
+    bool accept(char c) {
+        skip();
+        if (pos_ < source_.size() && source_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!accept(c))
+            error(std::string("expected '") + c + "'");
+    }
+
+    void skip() {
+        while (pos_ < source_.size() && std::isspace(static_cast<unsigned char>(source_[pos_])))
+            ++pos_;
+    }
+
+    void error(std::string const& message) {
+        error(message, pos_ + 1);
+    }
+
+    [[noreturn]] static void error(std::string const& message, size_t column) {
+        throw RuleError(message, column);
+    }
+
+    std::string const& source_;
+    size_t pos_;
+    RuleProgram::Code code_;
+};
+
+inline RuleProgram RuleProgram::compile(std::string const& source) {
+    return RuleCompiler(source).compile();
+}
+
+struct SatisfiesRule_ {
+protected:
+    bool matches(RuleProgram const& rule, string_ref actual) const {
+        return rule.run(actual);
+    }
+
+    template<typename T>
+    typename std::enable_if<is_number<T>::value, bool>::type
+    matches(RuleProgram const& rule, T actual) const {
+        return rule.run(actual);
+    }
+
+    void describe(std::ostream& o, RuleProgram const& rule) const {
+        o << rule.description();
+    }
+};
+
+using SatisfiesRule = Matcher<SatisfiesRule_,RuleProgram>;
+
+// compiles a rule, throwing RuleError if it's not valid
+inline SatisfiesRule rule(std::string const& source) {
+    return SatisfiesRule(RuleProgram::compile(source));
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_RULES_H_
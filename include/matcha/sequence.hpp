@@ -0,0 +1,256 @@
+/* vim: set sw=4 ts=4 et : */
+/* sequence.hpp: matching patterns of events in a stream
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_SEQUENCE_H_
+#define _MATCHA_SEQUENCE_H_
+
+#include "matcha.hpp"
+
+namespace matcha {
+
+// a step of a sequence matched by any number of consecutive events
+template<typename M>
+struct ZeroOrMore {
+    M matcher;
+
+    friend std::ostream& operator<<(std::ostream& o, ZeroOrMore const& step) {
+        return o << "zero or more " << step.matcher;
+    }
+};
+
+template<typename T, typename Policy>
+ZeroOrMore<Matcher<Policy,T>> zeroOrMore(Matcher<Policy,T> const& matcher) {
+    return ZeroOrMore<Matcher<Policy,T>>{ matcher };
+}
+
+template<typename Step>
+struct is_zero_or_more : std::false_type
+{ };
+
+template<typename M>
+struct is_zero_or_more<ZeroOrMore<M>> : std::true_type
+{ };
+
+template<typename M>
+M const& step_matcher(M const& matcher) {
+    return matcher;
+}
+
+template<typename M>
+M const& step_matcher(ZeroOrMore<M> const& step) {
+    return step.matcher;
+}
+
+// the steps of a sequence and the most events a match may span
+template<typename Steps>
+struct SequencePattern {
+    static constexpr size_t unbounded = size_t(-1);
+
+    Steps steps;
+    size_t window;
+};
+
+// the outcome of a scan, for the failure report
+struct SequenceScan {
+    bool matched;
+    size_t events;
+    size_t furthest;
+    size_t furthestAt;
+};
+
+/*
+ * runs a sequence over events as they arrive, as a nondeterministic
+ * automaton with one state per step: state i means the first i steps
+ * have matched the latest events. For each state only the latest event
+ * a partial match may have started at is kept (any earlier start has the
+ * same future and a longer span), so memory stays O(states) whatever the
+ * length of the stream.
+ */
+template<typename... Steps>
+class SequenceScanner {
+public:
+    explicit SequenceScanner(SequencePattern<std::tuple<Steps...>> const& pattern)
+        : pattern_(pattern), time_(0), furthest_(0), furthestAt_(0)
+    {
+        start_.fill(0);
+        matched_ = skippable(0);
+    }
+
+    // feeds the next event, true once the sequence has been seen
+    template<typename E>
+    bool push(E const& event) {
+        if (matched_)
+            return true;
+
+        // a new attempt may begin at every event
+        start_[0] = time_ + 1;
+        close(start_);
+
+        std::array<size_t, N + 1> next;
+        next.fill(0);
+        advance(event, next);
+        close(next);
+
+        for (size_t i = 1; i <= N; ++i) {
+            if (next[i] && time_ + 1 - next[i] >= pattern_.window)
+                next[i] = 0;
+            if (next[i] && i > furthest_) {
+                furthest_ = i;
+                furthestAt_ = time_;
+            }
+        }
+        start_ = next;
+        ++time_;
+        return matched_ = start_[N] != 0;
+    }
+
+    bool matched() const { return matched_; }
+
+    // number of events fed so far
+    size_t events() const { return time_; }
+
+    // the most steps matched by a partial match, and the event it reached them at
+    size_t furthest() const { return furthest_; }
+    size_t furthestAt() const { return furthestAt_; }
+
+private:
+    static constexpr size_t N = sizeof...(Steps);
+
+    static bool skippable(size_t i) {
+        const bool skip[] = { is_zero_or_more<Steps>::value... };
+        for (; i < N; ++i)
+            if (!skip[i])
+                return false;
+        return true;
+    }
+
+    // steps matching no events: carries each state over its zeroOrMore steps
+    static void close(std::array<size_t, N + 1>& states) {
+        const bool skip[] = { is_zero_or_more<Steps>::value... };
+        for (size_t i = 0; i < N; ++i)
+            if (skip[i] && states[i])
+                states[i + 1] = std::max(states[i + 1], states[i]);
+    }
+
+    template<std::size_t I = 0, typename E>
+    typename std::enable_if<I == sizeof...(Steps), void>::type
+    advance(E const&, std::array<size_t, N + 1>&) const
+    { }
+
+    template<std::size_t I = 0, typename E>
+    typename std::enable_if<I < sizeof...(Steps), void>::type
+    advance(E const& event, std::array<size_t, N + 1>& next) const {
+        typedef typename std::tuple_element<I, std::tuple<Steps...>>::type step_type;
+        if (start_[I] && step_matcher(std::get<I>(pattern_.steps)).matches(event)) {
+            size_t to = is_zero_or_more<step_type>::value ? I : I + 1;
+            next[to] = std::max(next[to], start_[I]);
+        }
+        advance<I + 1>(event, next);
+    }
+
+    SequencePattern<std::tuple<Steps...>> pattern_;
+    std::array<size_t, N + 1> start_;   // 1 + the event a state started at, or 0 if inactive
+    size_t time_;
+    bool matched_;
+    size_t furthest_;
+    size_t furthestAt_;
+};
+
+/*
+ * matches a range of events in which the steps match consecutive events.
+ * The outcome of the scan is kept for the failure report in a LastMatch
+ * slot of the calling thread, as the events of a live feed can't be read
+ * twice.
+ */
+struct Sequence_ {
+protected:
+    template<typename... Steps, typename C>
+    bool matches(SequencePattern<std::tuple<Steps...>> const& pattern, C const& events) const {
+        SequenceScan outcome = scan(pattern, events);
+        LastMatch<SequenceScan>::record(&pattern, &events, outcome);
+        return outcome.matched;
+    }
+
+    template<typename... Steps>
+    void describe(std::ostream& o, SequencePattern<std::tuple<Steps...>> const& pattern) const {
+        o << "a sequence of ";
+        printall(o, pattern.steps);
+        if (pattern.window != pattern.unbounded)
+            o << " within " << pattern.window << " events";
+    }
+
+    // the scan made by matches(), or a new one if there is none
+    template<typename... Steps, typename C>
+    void describeMismatch(std::ostream& o, SequencePattern<std::tuple<Steps...>> const& pattern,
+                          C const& events) const {
+        SequenceScan const* recorded = LastMatch<SequenceScan>::find(&pattern, &events);
+        SequenceScan outcome = recorded ? *recorded : scan(pattern, events);
+        o << outcome.events << " events without it";
+        if (outcome.furthest)
+            o << ", at most " << outcome.furthest << " of " << sizeof...(Steps)
+              << " steps matched, up to event #" << outcome.furthestAt;
+    }
+
+private:
+    template<typename... Steps, typename C>
+    static SequenceScan scan(SequencePattern<std::tuple<Steps...>> const& pattern, C const& events) {
+        SequenceScanner<Steps...> scanner(pattern);
+        for (auto it = std::begin(events); it != std::end(events) && !scanner.push(*it); ++it)
+            ;
+        return SequenceScan{ scanner.matched(), scanner.events(), scanner.furthest(), scanner.furthestAt() };
+    }
+
+    template<std::size_t I = 0, typename... Tp>
+    typename std::enable_if<I == sizeof...(Tp) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Tp...> const& t) const {
+        o << std::get<I>(t);
+    }
+
+    template<std::size_t I = 0, typename... Tp>
+    typename std::enable_if<I < sizeof...(Tp) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Tp...> const& t) const {
+        o << std::get<I>(t) << ", then ";
+        printall<I + 1, Tp...>(o, t);
+    }
+};
+
+template<typename T>
+using Sequence = Matcher<Sequence_,T>;
+
+template<typename First, typename... Rest>
+Sequence<SequencePattern<std::tuple<First,Rest...>>> sequence(First const& first, Rest const&... rest) {
+    typedef SequencePattern<std::tuple<First,Rest...>> pattern_type;
+    return Sequence<pattern_type>(pattern_type{ std::make_tuple(first, rest...),
+                                                pattern_type::unbounded });
+}
+
+// the same sequence, matching only if it spans at most `events` events
+template<typename Steps>
+Sequence<SequencePattern<Steps>> within(size_t events, Sequence<SequencePattern<Steps>> const& seq) {
+    return Sequence<SequencePattern<Steps>>(SequencePattern<Steps>{ seq.expected().steps, events });
+}
+
+// a scanner for a live feed, fed one event at a time with push()
+template<typename... Steps>
+SequenceScanner<Steps...> scanner(Sequence<SequencePattern<std::tuple<Steps...>>> const& seq) {
+    return SequenceScanner<Steps...>(seq.expected());
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_SEQUENCE_H_
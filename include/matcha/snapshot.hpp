@@ -0,0 +1,141 @@
+/* vim: set sw=4 ts=4 et : */
+/* snapshot.hpp: comparing large outputs against golden files
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_SNAPSHOT_H_
+#define _MATCHA_SNAPSHOT_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include "mapped_file.hpp"
+
+namespace matcha {
+
+/*
+ * a golden file, and whether to overwrite it with the actual output.
+ * MATCHA_UPDATE_SNAPSHOTS=1 turns updating on for every snapshot.
+ */
+struct Snapshot {
+    static bool updatingFromEnvironment() {
+        const char* update = std::getenv("MATCHA_UPDATE_SNAPSHOTS");
+        return update && *update && std::string(update) != "0";
+    }
+
+    std::string path;
+    bool update;
+};
+
+/*
+ * matches text equal to the contents of a golden file. The file is mapped
+ * rather than read, and compared a chunk at a time, so neither side is
+ * ever copied and a difference early in a huge output is found without
+ * touching the rest. A missing golden file is written from the actual
+ * text, as is every golden file in update mode.
+ */
+struct MatchesSnapshot_ {
+protected:
+    bool matches(Snapshot const& snapshot, string_ref actual) const {
+        if (snapshot.update || ::access(snapshot.path.c_str(), F_OK) != 0)
+            return write(snapshot.path, actual);
+
+        MappedFile golden(snapshot.path);
+        return golden.size() == actual.size() && mismatch(golden, actual) == actual.size();
+    }
+
+    void describe(std::ostream& o, Snapshot const& snapshot) const {
+        o << "text matching the snapshot in " << snapshot.path;
+    }
+
+    void describeMismatch(std::ostream& o, Snapshot const& snapshot, string_ref actual) const {
+        if (snapshot.update || ::access(snapshot.path.c_str(), F_OK) != 0) {
+            o << "text that couldn't be written to " << snapshot.path;
+            return;
+        }
+
+        MappedFile golden(snapshot.path);
+        size_t at = mismatch(golden, actual);
+        size_t line = 1 + std::count(golden.begin(), golden.begin() + at, '\n');
+        const char* bol = golden.begin() + at;
+        while (bol != golden.begin() && bol[-1] != '\n')
+            --bol;
+        size_t column = golden.begin() + at - bol;
+
+        o << actual.size() << " bytes, differing from the " << golden.size()
+          << " of the snapshot at line " << line << ", column " << column + 1 << "\n"
+          << "  snapshot: ";
+        print_line(o, string_ref(golden), at - column, column);
+        o << "\n  actual  : ";
+        print_line(o, actual, at - column, column);
+    }
+
+private:
+    static constexpr size_t chunk = 64 * 1024;
+    static constexpr size_t context = 40;
+
+    // offset of the first difference, or the size of the shorter text
+    static size_t mismatch(string_ref golden, string_ref actual) {
+        size_t n = std::min(golden.size(), actual.size());
+        size_t at = 0;
+        for (; at + chunk <= n; at += chunk)
+            if (std::memcmp(golden.data() + at, actual.data() + at, chunk))
+                break;
+        const char* g = golden.data() + at;
+        const char* a = actual.data() + at;
+        size_t left = std::min(n - at, size_t(chunk));
+        return at + (std::mismatch(g, g + left, a).first - g);
+    }
+
+    // the line starting at bol, cut down to some context around column
+    static void print_line(std::ostream& o, string_ref text, size_t bol, size_t column) {
+        if (bol >= text.size()) {
+            o << "<end of text>";
+            return;
+        }
+        const char* begin = text.data() + bol;
+        const char* end = text.end();
+        const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        eol = eol ? eol : end;
+
+        const char* from = begin + (column > context ? column - context : 0);
+        const char* to = begin + std::min<size_t>(eol - begin, column + context);
+        o << (from != begin ? "..." : "") << "\"" << string_ref(from, to - from) << "\""
+          << (to != eol ? "..." : "");
+    }
+
+    static bool write(std::string const& path, string_ref text) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp.c_str(), std::ios::binary);
+            out.write(text.data(), text.size());
+            if (!out)
+                return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
+
+using MatchesSnapshot = Matcher<MatchesSnapshot_,Snapshot>;
+
+inline MatchesSnapshot matchesSnapshot(std::string const& path,
+                                       bool update = Snapshot::updatingFromEnvironment()) {
+    return MatchesSnapshot(Snapshot{ path, update });
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_SNAPSHOT_H_
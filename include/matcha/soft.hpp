@@ -0,0 +1,188 @@
+/* vim: set sw=4 ts=4 et : */
+/* soft.hpp: soft assertions, collected from many threads
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_SOFT_H_
+#define _MATCHA_SOFT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "matcha.hpp"
+
+// like assertThat, but the failure is only reported when `soft` goes out of scope
+#define softAssertThat(soft, actual, matcher) \
+    (soft).check(actual, matcher, __FILE__, __LINE__)
+
+namespace matcha {
+
+struct SoftFailure {
+    const char* file;
+    int line;
+    std::string message;
+};
+
+/*
+ * collects the failures of soft assertions made from any number of
+ * threads, and reports them all when it goes out of scope, e.g.
+ *
+ *   SoftAssertions soft;
+ *   for (auto& t : workers)
+ *       t = std::thread([&] { softAssertThat(soft, compute(), greaterThan(0)); });
+ *   for (auto& t : workers)
+ *       t.join();
+ *   // failures are reported here
+ *
+ * Passing assertions touch no shared state at all. A failing one formats
+ * its message on the calling thread, through a FormatBuffer, and appends
+ * it to a buffer owned by that thread; buffers are linked into the
+ * collector with a single compare-and-swap, the first time a thread
+ * fails. Every thread must be done asserting before the collector
+ * reports. report() can be called any number of times: each call reports
+ * the failures collected since the previous one.
+ */
+class SoftAssertions {
+public:
+    SoftAssertions() : id_(next_id()), head_(nullptr)
+    { }
+
+    SoftAssertions(SoftAssertions const&) = delete;
+    SoftAssertions& operator=(SoftAssertions const&) = delete;
+
+    ~SoftAssertions() {
+        report();
+        for (Buffer* b = head_.load(std::memory_order_acquire); b; ) {
+            Buffer* next = b->next;
+            delete b;
+            b = next;
+        }
+    }
+
+    template<class T, class Matcher>
+    bool check(T const& actual, Matcher const& matcher, const char* file = "", int line = 0) {
+        if (matcher.matches(actual))
+            return true;
+
+        FormatBuffer message;
+        FormatStream o(message);
+        describeFailure(o, actual, matcher);
+        buffer().failures.push_back(SoftFailure{ file, line, message.str() });
+        return false;
+    }
+
+    // the failures of all threads not reported yet, ordered by file and line
+    std::vector<SoftFailure> failures() const {
+        std::vector<SoftFailure> all;
+        for (Buffer* b = head_.load(std::memory_order_acquire); b; b = b->next)
+            all.insert(all.end(), b->failures.begin(), b->failures.end());
+        std::stable_sort(all.begin(), all.end(), [](SoftFailure const& a, SoftFailure const& b) {
+            int order = std::strcmp(a.file, b.file);
+            return order < 0 || (order == 0 && a.line < b.line);
+        });
+        return all;
+    }
+
+    // the number of threads that have failed an assertion of this collector
+    size_t threads() const {
+        size_t n = 0;
+        for (Buffer* b = head_.load(std::memory_order_acquire); b; b = b->next)
+            ++n;
+        return n;
+    }
+
+    // reports the failures collected since the last report through the test framework
+    void report() {
+        auto all = failures();
+        for (Buffer* b = head_.load(std::memory_order_acquire); b; b = b->next)
+            b->failures.clear();
+        for (size_t i = 0; i < all.size() && i < maxReported; ++i)
+            report_one(all[i].file, all[i].line, all[i].message);
+        if (all.size() > maxReported) {
+            std::ostringstream o;
+            o << "... and " << all.size() - maxReported << " more soft assertion failures";
+            report_one(all[maxReported].file, all[maxReported].line, o.str());
+        }
+    }
+
+private:
+    static constexpr size_t maxReported = 100;
+
+    struct Buffer {
+        std::thread::id thread;
+        std::vector<SoftFailure> failures;
+        Buffer* next;
+    };
+
+    // the buffer of the collector the calling thread last failed an assertion of
+    struct ThreadCache {
+        uint64_t owner;
+        Buffer* buffer;
+    };
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> next(1);
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static ThreadCache& thread_cache() {
+        static thread_local ThreadCache cache = { 0, nullptr };
+        return cache;
+    }
+
+    // the buffer of the calling thread, linked in the first time it fails.
+    // A thread going back and forth between collectors finds its buffer in
+    // the list again; the ids of finished threads may be reused, but by then
+    // their buffers are no longer written to
+    Buffer& buffer() {
+        ThreadCache& cache = thread_cache();
+        if (cache.owner == id_)
+            return *cache.buffer;
+
+        std::thread::id self = std::this_thread::get_id();
+        Buffer* b = head_.load(std::memory_order_acquire);
+        while (b && b->thread != self)
+            b = b->next;
+        if (!b) {
+            b = new Buffer;
+            b->thread = self;
+            b->next = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(b->next, b, std::memory_order_release,
+                                                std::memory_order_relaxed))
+                ;
+        }
+        cache.owner = id_;
+        cache.buffer = b;
+        return *b;
+    }
+
+    static void report_one(const char* file, int line, std::string const& message) {
+#if defined(MATCHA_GTEST)
+        ADD_FAILURE_AT(file, line) << message;
+#elif defined(MATCHA_BOOSTTEST)
+        BOOST_ERROR(file << ":" << line << ": " << message);
+#else
+        std::cout << file << ":" << line << ": " << message;
+#endif
+    }
+
+    uint64_t id_;
+    std::atomic<Buffer*> head_;
+};
+
+} // namespace matcha
+
+#endif // _MATCHA_SOFT_H_
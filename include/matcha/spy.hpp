@@ -0,0 +1,346 @@
+/* vim: set sw=4 ts=4 et : */
+/* spy.hpp: recording calls and verifying them with matchers
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_SPY_H_
+#define _MATCHA_SPY_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "matcha.hpp"
+
+namespace matcha {
+
+/*
+ * a small number identifying a thread, never 0. A thread's number is
+ * handed to the next thread asking for one once it exits, so the spy
+ * slots claimed under it are reused rather than exhausted.
+ */
+class ThreadToken {
+public:
+    ThreadToken() {
+        std::lock_guard<std::mutex> guard(lock());
+        if (released().empty())
+            value_ = ++last();
+        else {
+            value_ = released().back();
+            released().pop_back();
+        }
+    }
+
+    ThreadToken(ThreadToken const&) = delete;
+    ThreadToken& operator=(ThreadToken const&) = delete;
+
+    ~ThreadToken() {
+        std::lock_guard<std::mutex> guard(lock());
+        released().push_back(value_);
+    }
+
+    unsigned value() const { return value_; }
+
+private:
+    static std::mutex& lock() {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::vector<unsigned>& released() {
+        static std::vector<unsigned> tokens;
+        return tokens;
+    }
+
+    static unsigned& last() {
+        static unsigned n = 0;
+        return n;
+    }
+
+    unsigned value_;
+};
+
+inline unsigned thread_token() {
+    static thread_local ThreadToken token;
+    return token.value();
+}
+
+/*
+ * a string argument as a spy records it: up to 64 characters are copied
+ * inline, so recording doesn't allocate; longer ones are copied to the
+ * heap. Matchers see it as a string_ref.
+ */
+class RecordedString {
+public:
+    static constexpr size_t inlineCapacity = 64;
+
+    RecordedString() : size_(0)
+    { }
+
+    RecordedString(std::string const& s) : size_(s.size()) {
+        if (size_ <= inlineCapacity)
+            std::memcpy(local_, s.data(), size_);
+        else
+            heap_ = s;
+    }
+
+    string_ref ref() const {
+        return size_ <= inlineCapacity ? string_ref(local_, size_) : string_ref(heap_);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, RecordedString const& s) {
+        return o << s.ref();
+    }
+
+private:
+    size_t size_;
+    char local_[inlineCapacity];
+    std::string heap_;
+};
+
+// how a spy stores an argument of type T
+template<typename T>
+struct recorded {
+    typedef typename std::decay<T>::type type;
+};
+
+template<>
+struct recorded<std::string> {
+    typedef RecordedString type;
+};
+
+// what matchers are given for a recorded argument
+template<typename T>
+T const& recorded_value(T const& value) {
+    return value;
+}
+
+inline string_ref recorded_value(RecordedString const& value) {
+    return value.ref();
+}
+
+/*
+ * records the arguments of every call made to it, e.g.
+ *
+ *   Spy<int, std::string> onSend;
+ *   client.setSendHook([&](int id, std::string const& msg) { onSend(id, msg); });
+ *   ...
+ *   assertThat(onSend, calledWith(equalTo(3), startsWith("x")));
+ *
+ * Every thread calling the spy claims a slot of its own, with room for
+ * `capacity` calls allocated up front, so recording a call is a copy of
+ * the arguments and a couple of atomic loads and stores: no locks, no
+ * contention, and no allocations unless an argument allocates when copied
+ * (strings do past 64 characters). Calls beyond the capacity (or from
+ * more threads than there are slots) are counted, but not recorded. A
+ * thread's slot passes to a later thread once it exits.
+ *
+ * Recorded calls are meant to be checked once the calling threads are
+ * done, e.g. joined.
+ */
+template<typename... Args>
+class Spy {
+public:
+    typedef std::tuple<typename recorded<typename std::decay<Args>::type>::type...> call_type;
+
+    explicit Spy(size_t capacity = 1024, size_t threads = 16)
+        : capacity_(capacity), nslots_(threads), slots_(new Slot[threads]),
+          calls_(new call_type[capacity * threads]), dropped_(0)
+    { }
+
+    Spy(Spy const&) = delete;
+    Spy& operator=(Spy const&) = delete;
+
+    void operator()(Args const&... args) {
+        Slot* slot = claim();
+        size_t n = slot ? slot->size.load(std::memory_order_relaxed) : capacity_;
+        if (n == capacity_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        calls_[(slot - slots_.get()) * capacity_ + n] = call_type(args...);
+        slot->size.store(n + 1, std::memory_order_release);
+    }
+
+    // number of calls, recorded or not
+    size_t calls() const {
+        return recorded() + dropped_.load(std::memory_order_relaxed);
+    }
+
+    size_t recorded() const {
+        size_t n = 0;
+        for (size_t i = 0; i < nslots_; ++i)
+            n += slots_[i].size.load(std::memory_order_acquire);
+        return n;
+    }
+
+    // whether pred holds for any recorded call, thread by thread
+    template<typename Pred>
+    bool anyCall(Pred pred) const {
+        for (size_t i = 0; i < nslots_; ++i) {
+            size_t n = slots_[i].size.load(std::memory_order_acquire);
+            for (size_t j = 0; j < n; ++j)
+                if (pred(calls_[i * capacity_ + j]))
+                    return true;
+        }
+        return false;
+    }
+
+    void reset() {
+        for (size_t i = 0; i < nslots_; ++i)
+            slots_[i].size.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, Spy const& spy) {
+        return o << "<spy, " << spy.calls() << " calls>";
+    }
+
+private:
+    struct Slot {
+        Slot() : owner(0), size(0)
+        { }
+
+        std::atomic<unsigned> owner;
+        std::atomic<size_t> size;
+        char padding[64];
+    };
+
+    // the slot of the calling thread, claiming the first free one if needed
+    Slot* claim() {
+        unsigned me = thread_token();
+        for (size_t i = 0; i < nslots_; ++i) {
+            unsigned owner = slots_[i].owner.load(std::memory_order_acquire);
+            if (owner == me)
+                return &slots_[i];
+            if (owner == 0 && slots_[i].owner.compare_exchange_strong(owner, me))
+                return &slots_[i];
+        }
+        return nullptr;
+    }
+
+    size_t capacity_;
+    size_t nslots_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<call_type[]> calls_;
+    std::atomic<size_t> dropped_;
+};
+
+// the calls recorded by a spy, at most maxReported of them
+template<typename... Args>
+void print_calls(std::ostream& o, Spy<Args...> const& spy) {
+    static constexpr size_t maxReported = 10;
+    size_t shown = 0;
+
+    o << spy.calls() << (spy.calls() == 1 ? " call" : " calls");
+    spy.anyCall([&](typename Spy<Args...>::call_type const& call) {
+        o << (shown ? ", " : ": ") << call;
+        return ++shown == maxReported;
+    });
+    if (spy.calls() > shown && shown)
+        o << ", ...";
+}
+
+struct CalledWith_ {
+protected:
+    template<typename... Ms, typename... Args>
+    bool matches(std::tuple<Ms...> const& matchers, Spy<Args...> const& spy) const {
+        static_assert(sizeof...(Ms) == sizeof...(Args), "calledWith requires a matcher for every argument");
+        return spy.anyCall([&](typename Spy<Args...>::call_type const& call) {
+            return all_args(matchers, call);
+        });
+    }
+
+    template<typename... Ms>
+    void describe(std::ostream& o, std::tuple<Ms...> const& matchers) const {
+        o << "a spy called with (";
+        printall(o, matchers);
+        o << ")";
+    }
+
+    template<typename... Ms, typename... Args>
+    void describeMismatch(std::ostream& o, std::tuple<Ms...> const&, Spy<Args...> const& spy) const {
+        print_calls(o, spy);
+    }
+
+private:
+    template<std::size_t I = 0, typename... Ms, typename... Ts>
+    static typename std::enable_if<I == sizeof...(Ms), bool>::type
+    all_args(std::tuple<Ms...> const&, std::tuple<Ts...> const&) {
+        return true;
+    }
+
+    template<std::size_t I = 0, typename... Ms, typename... Ts>
+    static typename std::enable_if<I < sizeof...(Ms), bool>::type
+    all_args(std::tuple<Ms...> const& matchers, std::tuple<Ts...> const& call) {
+        return std::get<I>(matchers).matches(recorded_value(std::get<I>(call))) && all_args<I + 1>(matchers, call);
+    }
+
+    template<std::size_t I = 0, typename... Ms>
+    typename std::enable_if<I == sizeof...(Ms) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Ms...> const& t) const {
+        o << std::get<I>(t);
+    }
+
+    template<std::size_t I = 0, typename... Ms>
+    typename std::enable_if<I < sizeof...(Ms) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Ms...> const& t) const {
+        o << std::get<I>(t) << ", ";
+        printall<I + 1, Ms...>(o, t);
+    }
+};
+
+template<typename T>
+using CalledWith = Matcher<CalledWith_,T>;
+
+template<typename First, typename... Rest>
+CalledWith<std::tuple<First,Rest...>> calledWith(First const& first, Rest const&... rest) {
+    static_assert(is_matcher<First, Rest...>::value, "calledWith requires Matcher parameters");
+    return CalledWith<std::tuple<First,Rest...>>(std::make_tuple(first, rest...));
+}
+
+struct CalledTimes_ {
+protected:
+    template<typename M, typename... Args>
+    bool matches(M const& countMatcher, Spy<Args...> const& spy) const {
+        return countMatcher.matches(spy.calls());
+    }
+
+    template<typename M>
+    void describe(std::ostream& o, M const& countMatcher) const {
+        o << "a spy called " << countMatcher << " times";
+    }
+
+    template<typename M, typename... Args>
+    void describeMismatch(std::ostream& o, M const&, Spy<Args...> const& spy) const {
+        print_calls(o, spy);
+    }
+};
+
+template<typename T>
+using CalledTimes = Matcher<CalledTimes_,T>;
+
+template<typename T, typename Policy>
+CalledTimes<Matcher<Policy,T>> calledTimes(Matcher<Policy,T> const& countMatcher) {
+    return CalledTimes<Matcher<Policy,T>>(countMatcher);
+}
+
+inline CalledTimes<Matcher<IsEqual,size_t>> calledTimes(size_t n) {
+    return CalledTimes<Matcher<IsEqual,size_t>>(equalTo(n));
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_SPY_H_
@@ -0,0 +1,220 @@
+/* vim: set sw=4 ts=4 et : */
+/* table.hpp: column-wise matching of struct-of-arrays tables
+ *
+ * Copyright (C) 2014 Alexandre Moreno
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef _MATCHA_TABLE_H_
+#define _MATCHA_TABLE_H_
+
+#include <cstdint>
+#include "matcha.hpp"
+
+namespace matcha {
+
+// a matcher bound to the name of the column it checks
+template<typename M>
+struct Column {
+    std::string name;
+    M matcher;
+};
+
+template<typename T, typename Policy>
+Column<Matcher<Policy,T>> column(std::string const& name, Matcher<Policy,T> const& matcher) {
+    return Column<Matcher<Policy,T>>{ name, matcher };
+}
+
+/*
+ * matches a table given as a tuple of columns (e.g. std::tie(ids, prices)),
+ * the i-th column against the i-th column matcher. Each column is checked
+ * on its own, 64 rows at a time, packing the results into a bitmap word;
+ * the row bitmap is the AND of the column bitmaps.
+ */
+struct Table_ {
+protected:
+    template<typename... Ms, typename... Cs>
+    bool matches(std::tuple<Column<Ms>...> const& columns, std::tuple<Cs...> const& table) const {
+        static_assert(sizeof...(Ms) == sizeof...(Cs), "table requires a matcher for every column");
+        size_t rows = 0;
+        if (!same_rows(table, rows))
+            return false;
+        return all_columns(columns, table, rows);
+    }
+
+    template<typename... Ms>
+    void describe(std::ostream& o, std::tuple<Column<Ms>...> const& columns) const {
+        o << "a table where ";
+        printall(o, columns);
+    }
+
+    template<typename... Ms, typename... Cs>
+    void describeMismatch(std::ostream& o, std::tuple<Column<Ms>...> const& columns,
+                          std::tuple<Cs...> const& table) const {
+        size_t rows = 0;
+        if (!same_rows(table, rows)) {
+            o << "columns of different lengths";
+            return;
+        }
+
+        std::vector<uint64_t> bits((rows + 63) / 64, ~uint64_t(0));
+        and_columns(columns, table, rows, bits.data());
+
+        size_t failed = 0;
+        for (auto word : bits)
+            failed += popcount(~word);
+        o << failed << " of " << rows << " rows failed";
+
+        size_t shown = 0;
+        for (size_t i = 0; i < rows && shown < maxReported; ++i) {
+            if ((bits[i / 64] >> (i % 64)) & 1)
+                continue;
+            o << (shown++ ? ", " : ": ") << "#" << i << " (";
+            print_failed(o, columns, table, i, true);
+            o << ")";
+        }
+        if (failed > shown)
+            o << ", ...";
+    }
+
+private:
+    static constexpr size_t maxReported = 10;
+
+    static size_t popcount(uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_popcountll(x);
+#else
+        size_t n = 0;
+        for (; x; x &= x - 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    // the matcher outcome for 64 rows starting at base, one bit per row
+    template<typename M, typename It>
+    static uint64_t column_word(M const& matcher, It data, size_t base, size_t n) {
+        uint64_t word = 0;
+        for (size_t j = 0; j < n; ++j)
+            word |= uint64_t(matcher.matches(data[base + j])) << j;
+        return word;
+    }
+
+    template<typename M, typename C>
+    static bool column_matches(M const& matcher, C const& column, size_t rows) {
+        auto data = std::begin(column);
+        for (size_t base = 0; base < rows; base += 64) {
+            size_t n = std::min<size_t>(64, rows - base);
+            uint64_t all = n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+            if (column_word(matcher, data, base, n) != all)
+                return false;
+        }
+        return true;
+    }
+
+    template<typename M, typename C>
+    static void column_bits(M const& matcher, C const& column, size_t rows, uint64_t* bits) {
+        auto data = std::begin(column);
+        for (size_t base = 0; base < rows; base += 64) {
+            size_t n = std::min<size_t>(64, rows - base);
+            uint64_t pad = n == 64 ? 0 : ~uint64_t(0) << n;
+            bits[base / 64] &= column_word(matcher, data, base, n) | pad;
+        }
+    }
+
+    template<std::size_t I = 0, typename... Cs>
+    typename std::enable_if<I == sizeof...(Cs), bool>::type
+    same_rows(std::tuple<Cs...> const&, size_t&) const {
+        return true;
+    }
+
+    template<std::size_t I = 0, typename... Cs>
+    typename std::enable_if<I < sizeof...(Cs), bool>::type
+    same_rows(std::tuple<Cs...> const& t, size_t& rows) const {
+        size_t n = range_size(std::get<I>(t));
+        if (I == 0)
+            rows = n;
+        return n == rows && same_rows<I + 1, Cs...>(t, rows);
+    }
+
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I == sizeof...(Ms), bool>::type
+    all_columns(std::tuple<Column<Ms>...> const&, std::tuple<Cs...> const&, size_t) const {
+        return true;
+    }
+
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I < sizeof...(Ms), bool>::type
+    all_columns(std::tuple<Column<Ms>...> const& columns, std::tuple<Cs...> const& t, size_t rows) const {
+        return column_matches(std::get<I>(columns).matcher, std::get<I>(t), rows)
+            && all_columns<I + 1>(columns, t, rows);
+    }
+
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I == sizeof...(Ms), void>::type
+    and_columns(std::tuple<Column<Ms>...> const&, std::tuple<Cs...> const&, size_t, uint64_t*) const
+    { }
+
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I < sizeof...(Ms), void>::type
+    and_columns(std::tuple<Column<Ms>...> const& columns, std::tuple<Cs...> const& t,
+                size_t rows, uint64_t* bits) const {
+        column_bits(std::get<I>(columns).matcher, std::get<I>(t), rows, bits);
+        and_columns<I + 1>(columns, t, rows, bits);
+    }
+
+    // names of the columns failing at the given row
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I == sizeof...(Ms), void>::type
+    print_failed(std::ostream&, std::tuple<Column<Ms>...> const&, std::tuple<Cs...> const&,
+                 size_t, bool) const
+    { }
+
+    template<std::size_t I = 0, typename... Ms, typename... Cs>
+    typename std::enable_if<I < sizeof...(Ms), void>::type
+    print_failed(std::ostream& o, std::tuple<Column<Ms>...> const& columns,
+                 std::tuple<Cs...> const& t, size_t row, bool first) const {
+        auto const& item = std::begin(std::get<I>(t))[row];
+        if (!std::get<I>(columns).matcher.matches(item)) {
+            o << (first ? "" : ", ") << std::get<I>(columns).name << " = " << item;
+            first = false;
+        }
+        print_failed<I + 1>(o, columns, t, row, first);
+    }
+
+    template<std::size_t I = 0, typename... Ms>
+    typename std::enable_if<I == sizeof...(Ms) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Column<Ms>...> const& t) const {
+        o << std::get<I>(t).name << " " << std::get<I>(t).matcher << ".";
+    }
+
+    template<std::size_t I = 0, typename... Ms>
+    typename std::enable_if<I < sizeof...(Ms) - 1, void>::type
+    printall(std::ostream& o, std::tuple<Column<Ms>...> const& t) const {
+        o << std::get<I>(t).name << " " << std::get<I>(t).matcher << " and ";
+        printall<I + 1>(o, t);
+    }
+};
+
+template<typename T>
+using Table = Matcher<Table_,T>;
+
+template<typename First, typename... Rest>
+Table<std::tuple<Column<First>,Column<Rest>...>> table(Column<First> const& first, Column<Rest> const& ... rest) {
+    return Table<std::tuple<Column<First>,Column<Rest>...>>(std::make_tuple(first, rest...));
+}
+
+} // namespace matcha
+
+#endif // _MATCHA_TABLE_H_